@@ -0,0 +1,1108 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "graph.h"
+#include "city.h"
+#include "geo.h"
+#include "route.h"
+#include "spatial.h"
+#include "flood.h"
+#include "depot.h"
+#include "testgraph.h"
+#include "data.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static void usage(const char *prog) {
+    printf("Usage: %s <benchmark> [options]\n", prog);
+    printf("Benchmarks:\n");
+    printf("  load [maxnodes]              : graph build and teardown time for doubling node counts\n");
+    printf("  route <city|grid:N> [queries]: every router (incl. hierarchy build) on random pairs,\n");
+    printf("                                 checked against Dijkstra\n");
+    printf("  diameter [maxpoints]         : convex-hull diameter vs the all-pairs reference\n");
+    printf("  roaddiameter <city|grid:N>   : routeDiameter() time per thread count\n");
+    printf("  haversine [points]           : haversineMany() vs haversine() per point, with the largest difference\n");
+    printf("  nearest <city|grid:N> [queries]: spatial index nearest-k / radius vs haversine to every POI\n");
+    printf("  heap <city|grid:N> [queries] : queue push/pop throughput and road query time per heap kind\n");
+    printf("  flood <city|grid:N> [steps]  : floodStep() time per step and per element over a storm\n");
+    printf("  ensemble <city|grid:N> [scenarios] [steps]\n");
+    printf("                               : floodEnsemble() per thread count over random storm cells\n");
+    printf("  isochrone <city|grid:N> [queries]: bounded searches for 0.5, 2 and 8 km against full Dijkstra\n");
+    printf("  depots <city|grid:N> [depots] [updates]: repairing depot shortest path trees after road changes\n");
+    printf("  overlay <city|grid:N> [queries]: routing under a storm's road closures, per router, as it floods\n");
+    printf("  validate [file|rows]         : validate() vs validateStream() throughput in MB/s\n");
+    printf("  matrix <city|grid:N> [origins] [targets]\n");
+    printf("                               : routeMatrix() per thread count vs one query per pair\n");
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// xorshift so runs are repeatable without touching rand()'s global state
+static unsigned int rng_state = 2463534242u;
+
+static unsigned int rng_next(void) {
+    unsigned int x = rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng_state = x;
+    return x;
+}
+
+// Distinct, scattered IDs in the style of OSM node IDs (mixed signs).
+static int* make_ids(int n) {
+    int *ids = malloc(sizeof(int) * n);
+    if (!ids) return NULL;
+    for (int i = 0; i < n; ++i) ids[i] = (int)((unsigned int) i * 2654435761u);
+    for (int i = n - 1; i > 0; --i) {
+        int j = rng_next() % (i + 1);
+        int tmp = ids[i]; ids[i] = ids[j]; ids[j] = tmp;
+    }
+    return ids;
+}
+
+#define LOAD_EDGES_PER_NODE 14
+
+static int bench_load(int argc, char **argv) {
+    int maxNodes = 256000;
+    if (argc > 0) maxNodes = atoi(argv[0]);
+    if (maxNodes < 1000) maxNodes = 1000;
+
+    printf("%10s %10s %12s %12s %14s %10s\n", "nodes", "edges", "build_ms", "ns/node", "ns/element", "free_ms");
+    for (int n = 1000; n <= maxNodes; n *= 2) {
+        int *ids = make_ids(n);
+        if (!ids) { fprintf(stderr, "Error: out of memory\n"); return 1; }
+
+        double start = now_ms();
+        graph_t *g = createGraph();
+        if (!g) { free(ids); fprintf(stderr, "Error: could not create graph\n"); return 1; }
+        for (int i = 0; i < n; ++i) addNode(g, ids[i], graphAlloc(g, 32));
+        for (int i = 0; i < n; ++i) {
+            for (int k = 1; k <= LOAD_EDGES_PER_NODE / 2; ++k) {
+                addEdge(g, ids[i], ids[(i + k) % n], (float) k, graphAlloc(g, 16));
+                addEdge(g, ids[i], ids[rng_next() % n], (float) k, graphAlloc(g, 16));
+            }
+        }
+        double elapsed = now_ms() - start;
+
+        int nodes = g->nodeCount;
+        int edges = g->edgeCount;
+        start = now_ms();
+        freeGraph(g);
+        double freed = now_ms() - start;
+
+        printf("%10d %10d %12.2f %12.1f %14.1f %10.3f\n", nodes, edges, elapsed,
+               elapsed * 1e6 / nodes, elapsed * 1e6 / (nodes + edges), freed);
+        free(ids);
+    }
+    return 0;
+}
+
+#define DIAMETER_BRUTE_MAX 8000
+
+static double rng_unit(void) {
+    return (rng_next() + 0.5) / 4294967296.0;
+}
+
+// Synthetic POI clouds around Ames: a uniform box, a gaussian blob and a
+// ring (every point near the hull, the hard case for the filter).
+static void make_cloud(city_poi_t *pts, int n, int shape) {
+    for (int i = 0; i < n; ++i) {
+        double dlat, dlon;
+        if (shape == 0 || shape == 3) {
+            dlat = rng_unit() - 0.5;
+            dlon = rng_unit() - 0.5;
+        } else if (shape == 1) {
+            double r = sqrt(-2.0 * log(rng_unit())), t = 2.0 * M_PI * rng_unit();
+            dlat = 0.15 * r * cos(t);
+            dlon = 0.15 * r * sin(t);
+        } else {
+            double r = 0.5 - 0.01 * rng_unit(), t = 2.0 * M_PI * rng_unit();
+            dlat = r * cos(t);
+            dlon = r * sin(t);
+        }
+        pts[i] = (city_poi_t){42.03 + 0.1 * dlat, -93.62 + 0.1 * dlon, 0, 0};
+        // "bad": the box with a NaN or infinite coordinate every 16 points.
+        if (shape == 3 && i % 16 == 5) pts[i].lat = i % 3 == 0 ? NAN : i % 3 == 1 ? INFINITY : -INFINITY;
+        if (shape == 3 && i % 16 == 11) pts[i].lon = i % 2 ? NAN : INFINITY;
+    }
+}
+
+static int bench_diameter(int argc, char **argv) {
+    static const char *shapes[] = {"box", "gauss", "ring", "bad"};
+    int maxPoints = 64000;
+    if (argc > 0) maxPoints = atoi(argv[0]);
+    if (maxPoints < 1000) maxPoints = 1000;
+
+    printf("%6s %10s %12s %12s %8s\n", "shape", "points", "brute_ms", "hull_ms", "match");
+    for (int shape = 0; shape < 4; ++shape) {
+        for (int n = 1000; n <= maxPoints; n *= 2) {
+            city_poi_t *pts = malloc(sizeof(city_poi_t) * n);
+            if (!pts) { fprintf(stderr, "Error: out of memory\n"); return 1; }
+            make_cloud(pts, n, shape);
+
+            int a, b;
+            double start = now_ms();
+            double d = geoDiameter(pts, n, &a, &b);
+            double hull = now_ms() - start;
+
+            if (n <= DIAMETER_BRUTE_MAX) {
+                int ra, rb;
+                start = now_ms();
+                double rd = geoDiameterBruteForce(pts, n, &ra, &rb);
+                double brute = now_ms() - start;
+                int match = rd == d && ra == a && rb == b;
+                printf("%6s %10d %12.2f %12.2f %8s\n", shapes[shape], n, brute, hull, match ? "yes" : "NO");
+                if (!match) { free(pts); return 1; }
+            } else {
+                printf("%6s %10d %12s %12.2f %8s\n", shapes[shape], n, "-", hull, "-");
+            }
+            free(pts);
+        }
+    }
+    return 0;
+}
+
+#define HAVERSINE_QUERIES 200
+
+// Spread of haversineMany() against haversine(): a city, a country-sized
+// cloud and points anywhere on the globe (mostly past the series, so
+// they take the haversine() fallback).
+static int bench_haversine(int argc, char **argv) {
+    static const char *sets[] = {"city", "country", "world"};
+    static const double spans[] = {0.1, 20.0, 360.0};
+    int n = 4096;
+    if (argc > 0) n = atoi(argv[0]);
+    if (n < 4) n = 4;
+
+    city_poi_t *pts = malloc(sizeof(city_poi_t) * n);
+    geo_points_t *soa = createGeoPoints(n);
+    double *fast = malloc(sizeof(double) * n);
+    double *exact = malloc(sizeof(double) * n);
+    if (!pts || !soa || !fast || !exact) {
+        free(pts); freeGeoPoints(soa); free(fast); free(exact);
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+
+    printf("haversineMany() kernel: %s, tolerance %g m\n", haversineManyKernel(), GEO_MANY_TOLERANCE_M);
+    printf("%8s %8s %12s %12s %10s %14s\n", "set", "points", "scalar_ns", "many_ns", "speedup", "max_diff_m");
+    int status = 0;
+    for (int set = 0; set < 3; ++set) {
+        for (int i = 0; i < n; ++i) {
+            double lat = 42.03 + spans[set] * (rng_unit() - 0.5), lon = -93.62 + spans[set] * (rng_unit() - 0.5);
+            if (set == 2) lat = asin(2.0 * rng_unit() - 1.0) * 180.0 / M_PI;
+            pts[i] = (city_poi_t){lat, lon, 0, 0};
+            geoPointsSet(soa, i, lat, lon);
+        }
+        double scalarTime = 0.0, manyTime = 0.0, worst = 0.0;
+        for (int q = 0; q < HAVERSINE_QUERIES; ++q) {
+            const city_poi_t *p = &pts[rng_next() % n];
+            double start = now_ms();
+            for (int i = 0; i < n; ++i) exact[i] = haversine(p->lat, p->lon, pts[i].lat, pts[i].lon);
+            scalarTime += now_ms() - start;
+            start = now_ms();
+            haversineMany(soa, 0, n, p->lat, p->lon, fast);
+            manyTime += now_ms() - start;
+            for (int i = 0; i < n; ++i) {
+                if (fabs(fast[i] - exact[i]) > worst) worst = fabs(fast[i] - exact[i]);
+            }
+        }
+        double pairs = (double) n * HAVERSINE_QUERIES;
+        printf("%8s %8d %12.2f %12.2f %10.2f %14.3g\n", sets[set], n, scalarTime * 1e6 / pairs, manyTime * 1e6 / pairs,
+               scalarTime / manyTime, worst);
+        if (!(worst <= GEO_MANY_TOLERANCE_M)) status = 1;
+    }
+
+    free(pts);
+    freeGeoPoints(soa);
+    free(fast);
+    free(exact);
+    return status;
+}
+
+#define VALIDATE_RUNS 3
+
+// A file both engines read to the end: rows POIs, then 2 * rows roads.
+// validate() scans the POI name right after the ID without skipping a
+// tab, so the two are separated by a space.
+static int write_validate_input(FILE *fp, int rows) {
+    fprintf(fp, "%d\n", rows);
+    for (int i = 0; i < rows; ++i) {
+        fprintf(fp, "%d Place %d\t%.7f\t%.7f\n", -i, i, 42.03 + (rng_unit() - 0.5), -93.62 + (rng_unit() - 0.5));
+    }
+    fprintf(fp, "%d\n", 2 * rows);
+    for (int i = 0; i < 2 * rows; ++i) {
+        int from = -(int)(rng_next() % rows), to = -(int)(rng_next() % rows);
+        if (i % 50 == 0) {
+            fprintf(fp, "%d\t%d\tNaN\t%.7f\t%.7f\tStreet %d\n", from, to, 42.03 + (rng_unit() - 0.5),
+                    -93.62 + (rng_unit() - 0.5), i);
+        } else {
+            fprintf(fp, "%d\t%d\t%.3f\t%.7f\t%.7f\tStreet %d\n", from, to, 1000.0 * rng_unit(),
+                    42.03 + (rng_unit() - 0.5), -93.62 + (rng_unit() - 0.5), i);
+        }
+    }
+    return ferror(fp) ? -1 : 0;
+}
+
+// Best of VALIDATE_RUNS for validate() (scanf on stdin) and validateStream().
+static int bench_validate(int argc, char **argv) {
+    char path[] = "/tmp/bench_validateXXXXXX";
+    const char *file = NULL;
+    int rows = 500000;
+    if (argc > 0 && access(argv[0], R_OK) == 0) file = argv[0];
+    else if (argc > 0) rows = atoi(argv[0]);
+    if (rows < 1) rows = 1;
+
+    if (!file) {
+        int fd = mkstemp(path);
+        FILE *fp = fd < 0 ? NULL : fdopen(fd, "w");
+        if (!fp || write_validate_input(fp, rows) != 0 || fclose(fp) != 0) {
+            if (fd >= 0) unlink(path);
+            fprintf(stderr, "Error: could not write %s\n", path);
+            return 1;
+        }
+        file = path;
+    }
+
+    FILE *fp = fopen(file, "rb");
+    if (!fp) { fprintf(stderr, "Error: could not open %s\n", file); return 1; }
+    fseek(fp, 0, SEEK_END);
+    double mb = ftell(fp) / 1e6;
+    fclose(fp);
+
+    double best[2] = {0.0, 0.0};
+    int results[2] = {0, 0};
+    for (int run = 0; run < VALIDATE_RUNS; ++run) {
+        for (int engine = 0; engine < 2; ++engine) {
+            double start = now_ms();
+            if (engine == 0) {
+                if (!freopen(file, "rb", stdin)) { fprintf(stderr, "Error: could not open %s\n", file); return 1; }
+                results[0] = validate();
+            } else {
+                if (!(fp = fopen(file, "rb"))) { fprintf(stderr, "Error: could not open %s\n", file); return 1; }
+                results[1] = validateStream(fp);
+                fclose(fp);
+            }
+            double elapsed = now_ms() - start;
+            if (run == 0 || elapsed < best[engine]) best[engine] = elapsed;
+        }
+    }
+    if (file == path) unlink(path);
+
+    printf("%8s %10s %12s %10s %8s\n", "engine", "MB", "ms", "MB/s", "result");
+    printf("%8s %10.1f %12.2f %10.1f %8d\n", "scanf", mb, best[0], mb * 1000.0 / best[0], results[0]);
+    printf("%8s %10.1f %12.2f %10.1f %8d\n", "stream", mb, best[1], mb * 1000.0 / best[1], results[1]);
+    printf("speedup %.2fx, results %s\n", best[0] / best[1], results[0] == results[1] ? "match" : "DIFFER");
+    return results[0] == results[1] ? 0 : 1;
+}
+
+/*
+ * N x N street grid around Ames, about 80 m between junctions. Each
+ * street is up to 30% longer than the straight line between its ends,
+ * like a real road network, so the A* heuristic is admissible.
+ */
+static city_t* make_grid_city(int side) {
+    strpool_t *names = createStrPool();
+    graph_t *g = createGraph();
+    if (!names || !g) { freeStrPool(names); freeGraph(g); return NULL; }
+
+    uint32_t poi = strpoolIntern(names, "Junction");
+    uint32_t road = strpoolIntern(names, "Street");
+    for (int i = 0; i < side * side; ++i) {
+        POIData *d = graphAlloc(g, sizeof(POIData));
+        d->name = poi;
+        d->lat = 42.0 + (i / side) * 0.00072;
+        d->lon = -93.7 + (i % side) * 0.00097;
+        addNode(g, i, d);
+    }
+    for (int i = 0; i < side * side; ++i) {
+        int next[2] = {i % side + 1 < side ? i + 1 : -1, i + side < side * side ? i + side : -1};
+        for (int k = 0; k < 2; ++k) {
+            if (next[k] < 0) continue;
+            POIData *a = getNode(g, i)->data, *b = getNode(g, next[k])->data;
+            float w = (float) (haversine(a->lat, a->lon, b->lat, b->lon) * (1.0 + 0.3 * rng_unit()));
+            RoadData *r1 = graphAlloc(g, sizeof(RoadData)), *r2 = graphAlloc(g, sizeof(RoadData));
+            r1->roadName = r2->roadName = road;
+            addEdge(g, i, next[k], w, r1);
+            addEdge(g, next[k], i, w, r2);
+        }
+    }
+    city_t *city = cityFromGraph(g, names);
+    freeGraph(g);
+    freeStrPool(names);
+    return city;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double*) a, y = *(const double*) b;
+    return x < y ? -1 : x > y;
+}
+
+static int bench_route(int argc, char **argv) {
+    if (argc < 1) { fprintf(stderr, "Error: route requires a city file or grid:N\n"); return 1; }
+    int queries = 200;
+    if (argc > 1) queries = atoi(argv[1]);
+    if (queries < 1) queries = 1;
+
+    city_t *city;
+    if (strncmp(argv[0], "grid:", 5) == 0) city = make_grid_city(atoi(argv[0] + 5) > 1 ? atoi(argv[0] + 5) : 2);
+    else city = loadCity(argv[0]);
+    if (!city) { fprintf(stderr, "Error: failed to load '%s'\n", argv[0]); return 1; }
+
+    int hadHierarchy = city->ch.nodeCount > 0;
+    double start = now_ms();
+    if (!cityAddHierarchy(city)) { freeCity(city); fprintf(stderr, "Error: could not build hierarchy\n"); return 1; }
+    double chBuild = now_ms() - start;
+
+    int n = city->net.nodeCount;
+    int *pairs = malloc(sizeof(int) * 2 * queries);
+    double *reference = malloc(sizeof(double) * queries);
+    double *times = malloc(sizeof(double) * queries);
+    search_workspace_t *ws = createWorkspace();
+    if (!pairs || !reference || !times || !ws) {
+        free(pairs); free(reference); free(times); freeWorkspace(ws); freeCity(city);
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+    for (int q = 0; q < 2 * queries; ++q) pairs[q] = rng_next() % n;
+
+    printf("nodes %d, edges %d, heuristic scale %.6f, %d queries\n",
+           n, city->net.edgeCount, city->heuristicScale, queries);
+    if (hadHierarchy) printf("hierarchy: from snapshot, %d shortcuts\n", city->ch.shortcuts);
+    else printf("hierarchy: built in %.1f ms, %d shortcuts\n", chBuild, city->ch.shortcuts);
+    printf("%10s %14s %12s %12s %12s %10s\n", "router", "settled/query", "mean_ms", "p50_ms", "p99_ms", "mismatch");
+    int status = 0;
+    for (int algo = 0; algo < ROUTE_ALGO_COUNT; ++algo) {
+        long long settledTotal = 0;
+        double total = 0.0;
+        int mismatches = 0;
+        for (int q = 0; q < queries; ++q) {
+            int settled;
+            double start = now_ms();
+            double d = routeQuery(ws, city, (route_algo_t) algo, pairs[2*q], pairs[2*q + 1], &settled);
+            times[q] = now_ms() - start;
+            total += times[q];
+            settledTotal += settled;
+            if (algo == ROUTE_DIJKSTRA) reference[q] = d;
+            // Hierarchy distances are summed in a different order.
+            else if (d != reference[q] && !(algo == ROUTE_CH && fabs(d - reference[q]) <= 1e-9 * reference[q])) mismatches++;
+        }
+        qsort(times, queries, sizeof(double), cmp_double);
+        printf("%10s %14.1f %12.3f %12.3f %12.3f %10d\n", routeAlgoName((route_algo_t) algo),
+               (double) settledTotal / queries, total / queries, times[queries / 2],
+               times[(int) (queries * 0.99)], mismatches);
+        if (mismatches) status = 1;
+    }
+
+    // Short queries (target one road away) are dominated by setup when
+    // each call allocates and clears per-node arrays.
+    int near = 0;
+    for (int q = 0; q < queries; ++q) {
+        int s = pairs[2*q];
+        if (city->net.offsets[s] == city->net.offsets[s + 1]) continue;
+        pairs[2*near] = s;
+        pairs[2*near + 1] = city->net.targets[city->net.offsets[s]];
+        near++;
+    }
+    if (near > 0) {
+        double fresh = now_ms();
+        for (int q = 0; q < near; ++q) routeDistance(city, ROUTE_DIJKSTRA, pairs[2*q], pairs[2*q + 1], NULL);
+        fresh = now_ms() - fresh;
+        double reused = now_ms();
+        for (int q = 0; q < near; ++q) routeQuery(ws, city, ROUTE_DIJKSTRA, pairs[2*q], pairs[2*q + 1], NULL);
+        reused = now_ms() - reused;
+        printf("neighbour queries (dijkstra, %d): %.4f ms with a new workspace, %.4f ms reusing one\n",
+               near, fresh / near, reused / near);
+    }
+
+    free(pairs);
+    free(reference);
+    free(times);
+    freeWorkspace(ws);
+    freeCity(city);
+    return status;
+}
+
+#define MATRIX_PAIRWISE_ROWS 5
+
+static int bench_matrix(int argc, char **argv) {
+    if (argc < 1) { fprintf(stderr, "Error: matrix requires a city file or grid:N\n"); return 1; }
+    int rows = argc > 1 ? atoi(argv[1]) : 200;
+    int cols = argc > 2 ? atoi(argv[2]) : 1500;
+    if (rows < 1) rows = 1;
+    if (cols < 1) cols = 1;
+
+    city_t *city;
+    if (strncmp(argv[0], "grid:", 5) == 0) city = make_grid_city(atoi(argv[0] + 5) > 1 ? atoi(argv[0] + 5) : 2);
+    else city = loadCity(argv[0]);
+    if (!city) { fprintf(stderr, "Error: failed to load '%s'\n", argv[0]); return 1; }
+
+    int n = city->net.nodeCount;
+    int *sources = malloc(sizeof(int) * rows);
+    int *targets = malloc(sizeof(int) * cols);
+    double *out = malloc(sizeof(double) * rows * cols);
+    if (!sources || !targets || !out) {
+        free(sources); free(targets); free(out); freeCity(city);
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < rows; ++i) sources[i] = rng_next() % n;
+    for (int j = 0; j < cols; ++j) targets[j] = rng_next() % n;
+
+    // The baseline: one early-exit Dijkstra per pair, for a few rows.
+    int sampleRows = rows < MATRIX_PAIRWISE_ROWS ? rows : MATRIX_PAIRWISE_ROWS;
+    double *pairwise = malloc(sizeof(double) * sampleRows * cols);
+    if (!pairwise) { free(sources); free(targets); free(out); freeCity(city); return 1; }
+    double start = now_ms();
+    for (int i = 0; i < sampleRows; ++i) {
+        for (int j = 0; j < cols; ++j)
+            pairwise[i * cols + j] = routeDistance(city, ROUTE_DIJKSTRA, sources[i], targets[j], NULL);
+    }
+    double perPair = (now_ms() - start) / (sampleRows * cols);
+
+    printf("nodes %d, edges %d, %d x %d matrix\n", n, city->net.edgeCount, rows, cols);
+    printf("pairwise dijkstra: %.3f ms/pair, ~%.0f ms for the matrix\n", perPair, perPair * rows * cols);
+    printf("%8s %12s %12s %10s\n", "threads", "total_ms", "us/cell", "mismatch");
+    int cpus = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    int status = 0;
+    for (int t = 1; t <= (cpus > 4 ? cpus : 4); t *= 2) {
+        start = now_ms();
+        if (!routeMatrix(city, sources, rows, targets, cols, HEAP_QUAD, t, out)) { status = 1; break; }
+        double elapsed = now_ms() - start;
+        int mismatches = 0;
+        for (int k = 0; k < sampleRows * cols; ++k) {
+            if (out[k] != pairwise[k] && !(isinf(out[k]) && isinf(pairwise[k]))) mismatches++;
+        }
+        printf("%8d %12.1f %12.3f %10d\n", t, elapsed, elapsed * 1000.0 / ((double) rows * cols), mismatches);
+        if (mismatches) status = 1;
+    }
+    printf("(%d CPUs online)\n", cpus);
+
+    free(pairwise);
+    free(sources);
+    free(targets);
+    free(out);
+    freeCity(city);
+    return status;
+}
+
+static int bench_roaddiameter(int argc, char **argv) {
+    if (argc < 1) { fprintf(stderr, "Error: roaddiameter requires a city file or grid:N\n"); return 1; }
+    city_t *city;
+    if (strncmp(argv[0], "grid:", 5) == 0) city = make_grid_city(atoi(argv[0] + 5) > 1 ? atoi(argv[0] + 5) : 2);
+    else city = loadCity(argv[0]);
+    if (!city) { fprintf(stderr, "Error: failed to load '%s'\n", argv[0]); return 1; }
+
+    printf("nodes %d, edges %d\n", city->net.nodeCount, city->net.edgeCount);
+    printf("%8s %12s %12s %10s %14s %10s\n", "threads", "total_ms", "us/source", "speedup", "diameter_m", "same");
+    int cpus = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    double serial = 0.0, first = 0.0;
+    int firstA = -1, firstB = -1, status = 0;
+    for (int t = 1; t <= (cpus > 4 ? cpus : 4); t *= 2) {
+        int a, b;
+        double start = now_ms();
+        double d = routeDiameter(city, HEAP_QUAD, t, NULL, &a, &b);
+        double elapsed = now_ms() - start;
+        if (isnan(d)) { fprintf(stderr, "Error: out of memory\n"); status = 1; break; }
+        if (t == 1) { serial = elapsed; first = d; firstA = a; firstB = b; }
+        int same = d == first && a == firstA && b == firstB;
+        printf("%8d %12.1f %12.3f %10.2f %14.2f %10s\n", t, elapsed, elapsed * 1000.0 / city->net.nodeCount,
+               serial / elapsed, d, same ? "yes" : "NO");
+        if (!same) status = 1;
+    }
+    printf("(%d CPUs online)\n", cpus);
+    freeCity(city);
+    return status;
+}
+
+/*
+ * A four-hour storm in one-minute steps (or the first half of the run,
+ * if shorter): rain rising linearly to 1.5 mm per step half way through
+ * it and falling back to 0, then dry while the water drains. Reports
+ * time per step and per element, the peak counts, and fails if the
+ * water does not balance.
+ */
+static int bench_flood(int argc, char **argv) {
+    if (argc < 1) { fprintf(stderr, "Error: flood requires a city file or grid:N\n"); return 1; }
+    int steps = argc > 1 ? atoi(argv[1]) : 2000;
+    if (steps < 4) steps = 4;
+    city_t *city;
+    if (strncmp(argv[0], "grid:", 5) == 0) city = make_grid_city(atoi(argv[0] + 5) > 1 ? atoi(argv[0] + 5) : 2);
+    else city = loadCity(argv[0]);
+    if (!city) { fprintf(stderr, "Error: failed to load '%s'\n", argv[0]); return 1; }
+
+    flood_model_t *model = createFloodModel(city, NULL);
+    flood_state_t *state = model ? createFloodState(model) : NULL;
+    double *rain = malloc(sizeof(double) * steps);
+    if (!state || !rain) {
+        fprintf(stderr, "Error: out of memory\n");
+        free(rain); freeFloodState(state); freeFloodModel(model); freeCity(city);
+        return 1;
+    }
+    int storm = steps / 2 < 240 ? steps / 2 : 240;
+    for (int i = 0; i < steps; ++i) {
+        double t = 2.0 * i / storm;
+        rain[i] = t < 1.0 ? 1.5 * t : t < 2.0 ? 1.5 * (2.0 - t) : 0.0;
+    }
+
+    int n = city->net.nodeCount, m = city->net.edgeCount, peakFlooded = 0, peakBlocked = 0;
+    double start = now_ms();
+    for (int i = 0; i < steps; ++i) {
+        floodStep(model, state, rain[i], NULL);
+        if (state->floodedNodes > peakFlooded) peakFlooded = state->floodedNodes;
+        if (state->impassableEdges > peakBlocked) peakBlocked = state->impassableEdges;
+    }
+    double elapsed = now_ms() - start;
+
+    double standing = 0.0;
+    for (int v = 0; v < n; ++v) standing += state->depth[v];
+    double imbalance = fabs(state->rained - state->drained - standing) / (state->rained > 0.0 ? state->rained : 1.0);
+    printf("nodes %d, edges %d, steps %d\n", n, m, steps);
+    printf("%12s %12s %14s %14s %14s %12s\n", "total_ms", "us/step", "ns/node-step", "ns/elem-step", "peak_flooded",
+           "peak_blocked");
+    printf("%12.1f %12.2f %14.2f %14.2f %14d %12d\n", elapsed, elapsed * 1000.0 / steps, elapsed * 1e6 / ((double) n * steps),
+           elapsed * 1e6 / ((double) (n + m) * steps), peakFlooded, peakBlocked);
+    printf("rained %.1f, drained %.1f, standing %.1f (mm over all nodes), relative imbalance %.2g\n", state->rained,
+           state->drained, standing, imbalance);
+
+    int status = imbalance <= 1e-9 ? 0 : 1;
+    free(rain);
+    freeFloodState(state);
+    freeFloodModel(model);
+    freeCity(city);
+    return status;
+}
+
+/*
+ * floodEnsemble() for 1, 2, 4... threads over random storm cells
+ * (peak 0.5-2 mm per step for 1-3 hours, 0.3-3 km across) around the
+ * city. The aggregates must match the single-threaded run exactly.
+ */
+static int bench_ensemble(int argc, char **argv) {
+    if (argc < 1) { fprintf(stderr, "Error: ensemble requires a city file or grid:N\n"); return 1; }
+    int count = argc > 1 ? atoi(argv[1]) : 64, steps = argc > 2 ? atoi(argv[2]) : 360;
+    if (count < 1) count = 1;
+    if (steps < 1) steps = 1;
+    city_t *city;
+    if (strncmp(argv[0], "grid:", 5) == 0) city = make_grid_city(atoi(argv[0] + 5) > 1 ? atoi(argv[0] + 5) : 2);
+    else city = loadCity(argv[0]);
+    if (!city) { fprintf(stderr, "Error: failed to load '%s'\n", argv[0]); return 1; }
+
+    int n = city->net.nodeCount;
+    flood_model_t *model = createFloodModel(city, NULL);
+    flood_scenario_t *storms = malloc(sizeof(flood_scenario_t) * count);
+    double *depth[2] = {malloc(sizeof(double) * (n + 1)), malloc(sizeof(double) * (n + 1))};
+    int *flooded[2] = {malloc(sizeof(int) * (n + 1)), malloc(sizeof(int) * (n + 1))};
+    int *first[2] = {malloc(sizeof(int) * (n + 1)), malloc(sizeof(int) * (n + 1))};
+    int status = 0;
+    if (!model || !storms || !depth[0] || !depth[1] || !flooded[0] || !flooded[1] || !first[0] || !first[1]) {
+        fprintf(stderr, "Error: out of memory\n");
+        status = 1;
+        goto done;
+    }
+    for (int i = 0; i < count; ++i) {
+        const city_poi_t *p = &city->pois[rng_next() % n];
+        storms[i] = (flood_scenario_t){0.5 + 1.5 * rng_unit(), 60 + (int) (rng_next() % 121), p->lat, p->lon,
+                                       300.0 + 2700.0 * rng_unit()};
+    }
+
+    printf("nodes %d, edges %d, scenarios %d, steps %d\n", n, city->net.edgeCount, count, steps);
+    printf("%8s %12s %14s %10s %10s\n", "threads", "total_ms", "ms/scenario", "speedup", "same");
+    int cpus = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    double serial = 0.0;
+    for (int t = 1; t <= (cpus > 4 ? cpus : 4); t *= 2) {
+        int r = t == 1 ? 0 : 1;
+        double start = now_ms();
+        int ok = floodEnsemble(model, storms, count, steps, t, depth[r], flooded[r], first[r]);
+        double elapsed = now_ms() - start;
+        if (!ok) { fprintf(stderr, "Error: out of memory\n"); status = 1; break; }
+        if (t == 1) serial = elapsed;
+        int same = memcmp(depth[0], depth[r], sizeof(double) * n) == 0 &&
+                   memcmp(flooded[0], flooded[r], sizeof(int) * n) == 0 && memcmp(first[0], first[r], sizeof(int) * n) == 0;
+        printf("%8d %12.1f %14.2f %10.2f %10s\n", t, elapsed, elapsed / count, serial / elapsed, same ? "yes" : "NO");
+        if (!same) status = 1;
+    }
+    printf("(%d CPUs online)\n", cpus);
+
+done:
+    for (int r = 0; r < 2; ++r) {
+        free(depth[r]);
+        free(flooded[r]);
+        free(first[r]);
+    }
+    free(storms);
+    freeFloodModel(model);
+    freeCity(city);
+    return status;
+}
+
+#define OVERLAY_TICKS 120
+#define OVERLAY_EVERY 20
+
+/*
+ * Routing during a storm cell (4 mm per step for the first half, 3 km
+ * across, on a random node). Each tick advances the flood and updates
+ * the closures overlay; every OVERLAY_EVERY ticks the same random
+ * pairs are routed with each router under the overlay and checked
+ * against Dijkstra under it. detour counts pairs the closures made
+ * longer or unreachable.
+ */
+static int bench_overlay(int argc, char **argv) {
+    if (argc < 1) { fprintf(stderr, "Error: overlay requires a city file or grid:N\n"); return 1; }
+    int queries = argc > 1 ? atoi(argv[1]) : 50;
+    if (queries < 1) queries = 1;
+    city_t *city;
+    if (strncmp(argv[0], "grid:", 5) == 0) city = make_grid_city(atoi(argv[0] + 5) > 1 ? atoi(argv[0] + 5) : 2);
+    else city = loadCity(argv[0]);
+    if (!city) { fprintf(stderr, "Error: failed to load '%s'\n", argv[0]); return 1; }
+    if (!cityAddHierarchy(city)) { freeCity(city); fprintf(stderr, "Error: could not build hierarchy\n"); return 1; }
+
+    int n = city->net.nodeCount, status = 0;
+    flood_model_t *model = createFloodModel(city, NULL);
+    flood_state_t *state = model ? createFloodState(model) : NULL;
+    route_overlay_t *overlay = createRouteOverlay(city);
+    search_workspace_t *ws = createWorkspace();
+    float *cell = malloc(sizeof(float) * (n + 1));
+    int *pairs = malloc(sizeof(int) * 2 * queries);
+    double *dry = malloc(sizeof(double) * queries), *reference = malloc(sizeof(double) * queries);
+    if (!state || !overlay || !ws || !cell || !pairs || !dry || !reference) {
+        fprintf(stderr, "Error: out of memory\n");
+        status = 1;
+        goto done;
+    }
+
+    const city_poi_t *centre = &city->pois[rng_next() % n];
+    for (int v = 0; v < n; ++v) {
+        double d = haversine(city->pois[v].lat, city->pois[v].lon, centre->lat, centre->lon) / 1500.0;
+        cell[v] = (float) exp(-0.5 * d * d);
+    }
+    for (int q = 0; q < 2 * queries; ++q) pairs[q] = rng_next() % n;
+    for (int q = 0; q < queries; ++q) dry[q] = routeQuery(ws, city, ROUTE_DIJKSTRA, pairs[2*q], pairs[2*q + 1], NULL);
+
+    printf("nodes %d, edges %d, %d queries every %d ticks\n", n, city->net.edgeCount, queries, OVERLAY_EVERY);
+    printf("%6s %10s %10s %12s", "tick", "closed", "changed", "update_us");
+    for (int algo = 0; algo < ROUTE_ALGO_COUNT; ++algo) printf(" %9s_ms", routeAlgoName((route_algo_t) algo));
+    printf(" %8s %9s\n", "detour", "mismatch");
+
+    double updateTime = 0.0;
+    int changed = 0;
+    for (int tick = 1; tick <= OVERLAY_TICKS; ++tick) {
+        floodStep(model, state, tick <= OVERLAY_TICKS / 2 ? 4.0 : 0.0, cell);
+        double start = now_ms();
+        floodUpdateOverlay(state, overlay);
+        updateTime += now_ms() - start;
+        changed += state->toggledCount;
+        if (tick % OVERLAY_EVERY != 0) continue;
+
+        printf("%6d %10d %10d %12.2f", tick, state->impassableEdges, changed, updateTime * 1000.0 / OVERLAY_EVERY);
+        int detours = 0, mismatches = 0;
+        for (int algo = 0; algo < ROUTE_ALGO_COUNT; ++algo) {
+            double total = 0.0;
+            for (int q = 0; q < queries; ++q) {
+                double start = now_ms();
+                double d = routeQueryOverlay(ws, city, (route_algo_t) algo, overlay, pairs[2*q], pairs[2*q + 1], NULL);
+                total += now_ms() - start;
+                if (algo == ROUTE_DIJKSTRA) {
+                    reference[q] = d;
+                    detours += d != dry[q];
+                } else if (d != reference[q] && !(fabs(d - reference[q]) <= 1e-9 * reference[q])) {
+                    mismatches++;
+                }
+            }
+            printf(" %12.3f", total / queries);
+        }
+        printf(" %8d %9d\n", detours, mismatches);
+        if (mismatches) status = 1;
+        updateTime = 0.0;
+        changed = 0;
+    }
+
+done:
+    free(cell);
+    free(pairs);
+    free(dry);
+    free(reference);
+    freeWorkspace(ws);
+    freeRouteOverlay(overlay);
+    freeFloodState(state);
+    freeFloodModel(model);
+    freeCity(city);
+    return status;
+}
+
+#define DEPOT_CHECKS 10
+
+/*
+ * Shelter refreshes: random batches of 1 to 4 roads are closed,
+ * penalised or reopened through an overlay and the depot tree is
+ * repaired with depotTreeSyncOverlay(). DEPOT_CHECKS times a tree is
+ * rebuilt from scratch over the same overlay, timed, and compared with
+ * the repaired one.
+ */
+static int bench_depots(int argc, char **argv) {
+    if (argc < 1) { fprintf(stderr, "Error: depots requires a city file or grid:N\n"); return 1; }
+    int depotCount = argc > 1 ? atoi(argv[1]) : 20;
+    int updates = argc > 2 ? atoi(argv[2]) : 1000;
+    if (depotCount < 1) depotCount = 1;
+    if (updates < DEPOT_CHECKS) updates = DEPOT_CHECKS;
+    city_t *city;
+    if (strncmp(argv[0], "grid:", 5) == 0) city = make_grid_city(atoi(argv[0] + 5) > 1 ? atoi(argv[0] + 5) : 2);
+    else city = loadCity(argv[0]);
+    if (!city) { fprintf(stderr, "Error: failed to load '%s'\n", argv[0]); return 1; }
+
+    int n = city->net.nodeCount, m = city->net.edgeCount, status = 0;
+    if (m == 0) { fprintf(stderr, "Error: the city has no roads\n"); freeCity(city); return 1; }
+    int *depots = malloc(sizeof(int) * depotCount);
+    double *times = malloc(sizeof(double) * updates);
+    route_overlay_t *overlay = createRouteOverlay(city);
+    depot_tree_t *tree = NULL;
+    if (!depots || !times || !overlay) { fprintf(stderr, "Error: out of memory\n"); status = 1; goto done; }
+    for (int i = 0; i < depotCount; ++i) depots[i] = rng_next() % n;
+
+    double start = now_ms();
+    tree = createDepotTree(city, overlay, depots, depotCount);
+    double build = now_ms() - start;
+    if (!tree) { fprintf(stderr, "Error: out of memory\n"); status = 1; goto done; }
+    printf("nodes %d, edges %d, %d depots, %d updates of 1-4 roads\n", n, m, depotCount, updates);
+
+    double rebuild = 0.0;
+    long affected = 0, settled = 0;
+    int mismatches = 0;
+    for (int u = 0; u < updates; ++u) {
+        int edges[4], count = 1 + rng_next() % 4;
+        for (int i = 0; i < count; ++i) {
+            int action = rng_next() % 3;
+            edges[i] = rng_next() % m;
+            routeOverlaySet(overlay, edges[i], action == 0 ? INFINITY : action == 1 ? 1.0f + 2.0f * (float) rng_unit() : 1.0f);
+        }
+        start = now_ms();
+        if (!depotTreeSyncOverlay(tree, overlay, edges, count)) { fprintf(stderr, "Error: out of memory\n"); status = 1; goto done; }
+        times[u] = now_ms() - start;
+        affected += tree->affected;
+        settled += tree->settled;
+        if ((u + 1) % (updates / DEPOT_CHECKS) != 0) continue;
+
+        start = now_ms();
+        depot_tree_t *fresh = createDepotTree(city, overlay, depots, depotCount);
+        rebuild += now_ms() - start;
+        if (!fresh) { fprintf(stderr, "Error: out of memory\n"); status = 1; goto done; }
+        for (int v = 0; v < n; ++v) {
+            double a = tree->dist[v], b = fresh->dist[v];
+            if (a != b && !(fabs(a - b) <= 1e-9 * b)) mismatches++;
+        }
+        freeDepotTree(fresh);
+    }
+
+    double total = 0.0;
+    for (int u = 0; u < updates; ++u) total += times[u];
+    qsort(times, updates, sizeof(double), cmp_double);
+    printf("%-10s %12s %12s %12s %12s\n", "", "mean_us", "p99_us", "affected", "settled");
+    printf("%-10s %12.1f %12.1f %12.1f %12.1f\n", "update", total * 1000.0 / updates,
+           times[(int) (0.99 * (updates - 1))] * 1000.0, (double) affected / updates, (double) settled / updates);
+    printf("%-10s %12.1f %12s %12s %12d\n", "rebuild", rebuild * 1000.0 / DEPOT_CHECKS, "-", "-", n);
+    printf("first build %.2f ms, %.0fx faster per update, %d distances differ\n", build,
+           rebuild / DEPOT_CHECKS / (total / updates), mismatches);
+    if (mismatches) status = 1;
+
+done:
+    freeDepotTree(tree);
+    freeRouteOverlay(overlay);
+    free(depots);
+    free(times);
+    freeCity(city);
+    return status;
+}
+
+/*
+ * Isochrones of 500 m, 2 km and 8 km from random origins, sharing one
+ * workspace, against the full Dijkstra row of routeMatrix() from the
+ * same origin: the nodes within the limit and their distances must be
+ * the same.
+ */
+static int bench_isochrone(int argc, char **argv) {
+    if (argc < 1) { fprintf(stderr, "Error: isochrone requires a city file or grid:N\n"); return 1; }
+    int queries = argc > 1 ? atoi(argv[1]) : 50;
+    if (queries < 1) queries = 1;
+    city_t *city;
+    if (strncmp(argv[0], "grid:", 5) == 0) city = make_grid_city(atoi(argv[0] + 5) > 1 ? atoi(argv[0] + 5) : 2);
+    else city = loadCity(argv[0]);
+    if (!city) { fprintf(stderr, "Error: failed to load '%s'\n", argv[0]); return 1; }
+
+    int n = city->net.nodeCount, status = 0;
+    const double limits[] = {500.0, 2000.0, 8000.0};
+    search_workspace_t *ws = createWorkspace();
+    int *origins = malloc(sizeof(int) * queries), *all = malloc(sizeof(int) * (n + 1));
+    double *full = malloc(sizeof(double) * (n + 1));
+    if (!ws || !origins || !all || !full) { fprintf(stderr, "Error: out of memory\n"); status = 1; goto done; }
+    for (int q = 0; q < queries; ++q) origins[q] = rng_next() % n;
+    for (int v = 0; v < n; ++v) all[v] = v;
+
+    printf("nodes %d, edges %d, %d origins\n", n, city->net.edgeCount, queries);
+    printf("%10s %12s %12s %12s %10s\n", "limit_m", "iso_ms", "full_ms", "reached", "mismatch");
+    for (int l = 0; l < 3; ++l) {
+        double isoTime = 0.0, fullTime = 0.0;
+        long reached = 0;
+        int mismatches = 0;
+        for (int q = 0; q < queries; ++q) {
+            int *nodes;
+            double *dists, start = now_ms();
+            int count = routeIsochrone(ws, city, NULL, origins[q], limits[l], &nodes, &dists);
+            isoTime += now_ms() - start;
+            start = now_ms();
+            int ok = routeMatrix(city, &origins[q], 1, all, n, HEAP_QUAD, 1, full);
+            fullTime += now_ms() - start;
+            if (count < 0 || !ok) { fprintf(stderr, "Error: out of memory\n"); free(nodes); free(dists); status = 1; goto done; }
+
+            int inside = 0;
+            for (int v = 0; v < n; ++v) inside += full[v] <= limits[l];
+            mismatches += inside != count;
+            for (int i = 0; i < count; ++i) mismatches += dists[i] != full[nodes[i]];
+            reached += count;
+            free(nodes);
+            free(dists);
+        }
+        printf("%10.0f %12.3f %12.3f %12.1f %10d\n", limits[l], isoTime / queries, fullTime / queries,
+               (double) reached / queries, mismatches);
+        if (mismatches) status = 1;
+    }
+
+done:
+    freeWorkspace(ws);
+    free(origins);
+    free(all);
+    free(full);
+    freeCity(city);
+    return status;
+}
+
+/*
+ * Queue traffic shaped like Dijkstra: keys never drop below the last
+ * popped one, and each pop is followed by two updates of random nodes
+ * (new entries, decreases, or ignored increases). Returns the number
+ * of queue calls made.
+ */
+static long queue_workout(search_workspace_t *ws, int n) {
+    long calls = 0;
+    workspaceReset(ws, n);
+    for (int v = 0; v < n / 4; ++v, ++calls) workspacePush(ws, 0, v, 0.0, rng_unit() * 1000.0);
+    while (workspaceQueued(ws, 0) > 0) {
+        heap_item_t it = workspacePop(ws, 0);
+        calls++;
+        if (ws->settled[0][it.idx] == ws->epoch) continue;
+        ws->settled[0][it.idx] = ws->epoch;
+        for (int k = 0; k < 2; ++k, ++calls) {
+            int v = rng_next() % n;
+            if (ws->settled[0][v] == ws->epoch) continue;
+            double key = it.dist + rng_unit() * 1000.0;
+            if (key < workspaceDist(ws, 0, v)) workspacePush(ws, 0, v, key, key);
+        }
+    }
+    return calls;
+}
+
+static int bench_heap(int argc, char **argv) {
+    if (argc < 1) { fprintf(stderr, "Error: heap requires a city file or grid:N\n"); return 1; }
+    int queries = argc > 1 ? atoi(argv[1]) : 200;
+    if (queries < 1) queries = 1;
+
+    city_t *city;
+    if (strncmp(argv[0], "grid:", 5) == 0) city = make_grid_city(atoi(argv[0] + 5) > 1 ? atoi(argv[0] + 5) : 2);
+    else city = loadCity(argv[0]);
+    if (!city) { fprintf(stderr, "Error: failed to load '%s'\n", argv[0]); return 1; }
+
+    int n = city->net.nodeCount;
+    int *pairs = malloc(sizeof(int) * 2 * queries);
+    double *reference = malloc(sizeof(double) * queries * ROUTE_ALGO_COUNT);
+    search_workspace_t *ws = createWorkspace();
+    if (!pairs || !reference || !ws) {
+        free(pairs); free(reference); freeWorkspace(ws); freeCity(city);
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+    for (int q = 0; q < 2 * queries; ++q) pairs[q] = rng_next() % n;
+
+    printf("nodes %d, edges %d, %d queries%s\n", n, city->net.edgeCount, queries,
+           city->ch.nodeCount ? "" : " (no hierarchy, ch skipped)");
+    printf("%8s %14s %12s\n", "heap", "queue_calls", "ns/call");
+    for (int kind = 0; kind < HEAP_KIND_COUNT; ++kind) {
+        ws->heapKind = (heap_kind_t) kind;
+        rng_state = 2463534242u;
+        double start = now_ms();
+        long calls = queue_workout(ws, 1 << 20);
+        double elapsed = now_ms() - start;
+        printf("%8s %14ld %12.1f\n", heapKindName((heap_kind_t) kind), calls, elapsed * 1e6 / calls);
+    }
+
+    printf("\n%10s %8s %12s %10s\n", "router", "heap", "mean_ms", "mismatch");
+    int status = 0;
+    for (int algo = 0; algo < ROUTE_ALGO_COUNT; ++algo) {
+        if (algo == ROUTE_CH && !city->ch.nodeCount) continue;
+        for (int kind = 0; kind < HEAP_KIND_COUNT; ++kind) {
+            ws->heapKind = (heap_kind_t) kind;
+            int mismatches = 0;
+            double start = now_ms();
+            for (int q = 0; q < queries; ++q) {
+                double d = routeQuery(ws, city, (route_algo_t) algo, pairs[2*q], pairs[2*q + 1], NULL);
+                double *ref = &reference[algo * queries + q];
+                if (kind == HEAP_BINARY) *ref = d;
+                else if (d != *ref) mismatches++;
+            }
+            double elapsed = now_ms() - start;
+            printf("%10s %8s %12.3f %10d\n", routeAlgoName((route_algo_t) algo), heapKindName((heap_kind_t) kind),
+                   elapsed / queries, mismatches);
+            if (mismatches) status = 1;
+        }
+    }
+
+    free(pairs);
+    free(reference);
+    freeWorkspace(ws);
+    freeCity(city);
+    return status;
+}
+
+typedef struct {
+    double dist;
+    int node;
+} scan_hit_t;
+
+static int cmp_scan_hit(const void *a, const void *b) {
+    const scan_hit_t *x = a, *y = b;
+    if (x->dist != y->dist) return x->dist < y->dist ? -1 : 1;
+    return x->node - y->node;
+}
+
+// The reference: haversine() to every POI (sorted afterwards).
+static int scan_pois(const city_t *city, double lat, double lon, scan_hit_t *hits) {
+    int count = 0;
+    for (int i = 0; i < city->net.nodeCount; ++i) {
+        const city_poi_t *p = &city->pois[i];
+        if (!isfinite(p->lat) || !isfinite(p->lon)) continue;
+        hits[count++] = (scan_hit_t){haversine(lat, lon, p->lat, p->lon), i};
+    }
+    return count;
+}
+
+#define NEAREST_RADIUS_M 250.0
+
+static int bench_nearest(int argc, char **argv) {
+    if (argc < 1) { fprintf(stderr, "Error: nearest requires a city file or grid:N\n"); return 1; }
+    int queries = argc > 1 ? atoi(argv[1]) : 500;
+    if (queries < 1) queries = 1;
+
+    city_t *city;
+    if (strncmp(argv[0], "grid:", 5) == 0) city = make_grid_city(atoi(argv[0] + 5) > 1 ? atoi(argv[0] + 5) : 2);
+    else city = loadCity(argv[0]);
+    if (!city) { fprintf(stderr, "Error: failed to load '%s'\n", argv[0]); return 1; }
+    if (city->spatialCount == 0) { freeCity(city); fprintf(stderr, "Error: no POI has coordinates\n"); return 1; }
+
+    // Query points are spread over the bounding box of the POIs.
+    double minLat = INFINITY, maxLat = -INFINITY, minLon = INFINITY, maxLon = -INFINITY;
+    for (uint32_t i = 0; i < city->spatialCount; ++i) {
+        const city_poi_t *p = &city->pois[city->spatial[i].node];
+        if (p->lat < minLat) minLat = p->lat;
+        if (p->lat > maxLat) maxLat = p->lat;
+        if (p->lon < minLon) minLon = p->lon;
+        if (p->lon > maxLon) maxLon = p->lon;
+    }
+
+    int n = city->net.nodeCount;
+    scan_hit_t *hits = malloc(sizeof(scan_hit_t) * n);
+    int *nodes = malloc(sizeof(int) * n);
+    double *dists = malloc(sizeof(double) * n);
+    double *points = malloc(sizeof(double) * 2 * queries);
+    if (!hits || !nodes || !dists || !points) {
+        free(hits); free(nodes); free(dists); free(points); freeCity(city);
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+    for (int q = 0; q < queries; ++q) {
+        points[2*q] = minLat + (maxLat - minLat) * rng_unit();
+        points[2*q + 1] = minLon + (maxLon - minLon) * rng_unit();
+    }
+
+    printf("%u POIs indexed, %d queries\n", city->spatialCount, queries);
+    printf("%14s %12s %12s %10s %10s\n", "query", "index_us", "scan_us", "hits/q", "mismatch");
+    int ks[] = {1, 10, 100};
+    int status = 0;
+    for (int t = 0; t < 4; ++t) {
+        int k = t < 3 ? ks[t] : 0;
+        long hitTotal = 0;
+        int mismatches = 0;
+        double indexTime = 0.0, scanTime = 0.0;
+        for (int q = 0; q < queries; ++q) {
+            double lat = points[2*q], lon = points[2*q + 1];
+            double start = now_ms();
+            int count;
+            int *found = nodes;
+            double *foundDists = dists;
+            if (k > 0) {
+                count = spatialNearest(city, lat, lon, k, nodes, dists);
+            } else {
+                count = spatialWithin(city, lat, lon, NEAREST_RADIUS_M, &found, &foundDists);
+            }
+            indexTime += now_ms() - start;
+
+            start = now_ms();
+            int total = scan_pois(city, lat, lon, hits);
+            scanTime += now_ms() - start;
+            // Sorting is only needed for the comparison, so it is not timed.
+            qsort(hits, total, sizeof(scan_hit_t), cmp_scan_hit);
+            int expect = k > 0 ? (k < total ? k : total) : 0;
+            if (k == 0) { while (expect < total && hits[expect].dist <= NEAREST_RADIUS_M) expect++; }
+
+            int same = count == expect;
+            for (int i = 0; same && i < count; ++i) same = found[i] == hits[i].node && foundDists[i] == hits[i].dist;
+            if (!same) mismatches++;
+            hitTotal += count;
+            if (k == 0) { free(found); free(foundDists); }
+        }
+        char label[32];
+        if (k > 0) snprintf(label, sizeof(label), "nearest k=%d", k);
+        else snprintf(label, sizeof(label), "within %.0f m", NEAREST_RADIUS_M);
+        printf("%14s %12.2f %12.2f %10.1f %10d\n", label, indexTime * 1000.0 / queries, scanTime * 1000.0 / queries,
+               (double) hitTotal / queries, mismatches);
+        if (mismatches) status = 1;
+    }
+
+    free(hits);
+    free(nodes);
+    free(dists);
+    free(points);
+    freeCity(city);
+    return status;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) { usage(argv[0]); return 1; }
+
+    if (strcmp(argv[1], "load") == 0) return bench_load(argc - 2, argv + 2);
+    if (strcmp(argv[1], "route") == 0) return bench_route(argc - 2, argv + 2);
+    if (strcmp(argv[1], "diameter") == 0) return bench_diameter(argc - 2, argv + 2);
+    if (strcmp(argv[1], "matrix") == 0) return bench_matrix(argc - 2, argv + 2);
+    if (strcmp(argv[1], "roaddiameter") == 0) return bench_roaddiameter(argc - 2, argv + 2);
+    if (strcmp(argv[1], "heap") == 0) return bench_heap(argc - 2, argv + 2);
+    if (strcmp(argv[1], "haversine") == 0) return bench_haversine(argc - 2, argv + 2);
+    if (strcmp(argv[1], "nearest") == 0) return bench_nearest(argc - 2, argv + 2);
+    if (strcmp(argv[1], "flood") == 0) return bench_flood(argc - 2, argv + 2);
+    if (strcmp(argv[1], "ensemble") == 0) return bench_ensemble(argc - 2, argv + 2);
+    if (strcmp(argv[1], "isochrone") == 0) return bench_isochrone(argc - 2, argv + 2);
+    if (strcmp(argv[1], "depots") == 0) return bench_depots(argc - 2, argv + 2);
+    if (strcmp(argv[1], "overlay") == 0) return bench_overlay(argc - 2, argv + 2);
+    if (strcmp(argv[1], "validate") == 0) return bench_validate(argc - 2, argv + 2);
+
+    fprintf(stderr, "Error: unknown benchmark '%s'\n", argv[1]);
+    usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,343 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "ch.h"
+#include "heap.h"
+
+typedef struct {
+    int to;
+    double w;
+} arc_t;
+
+typedef struct {
+    arc_t *arcs;
+    int count;
+    int space;
+} arc_list_t;
+
+/*
+ * Contraction state. For a remaining node, out[u] and in[u] hold its
+ * edges (original and shortcut, one per node pair, at the smallest
+ * weight) to other remaining nodes. Contracting v unlinks it from its
+ * neighbours' lists, so v's own lists are frozen as exactly its upward
+ * (out) and downward (in) edges: every node left has a higher rank.
+ * The witness search reuses dist[] between runs: an entry is valid
+ * only if stamp[] equals the current epoch.
+ */
+typedef struct {
+    int n;
+    arc_list_t *out;
+    arc_list_t *in;
+    char *contracted;
+    int *deleted;
+    double *dist;
+    unsigned *stamp;
+    unsigned epoch;
+    heap_item_t *heap;
+    int heapSpace;
+    int settleLimit;
+    int shortcuts;
+} builder_t;
+
+static int arc_push(arc_list_t *list, int to, double w) {
+    if (list->count == list->space) {
+        int space = list->space ? list->space * 2 : 4;
+        arc_t *grown = realloc(list->arcs, sizeof(arc_t) * space);
+        if (!grown) return 0;
+        list->arcs = grown;
+        list->space = space;
+    }
+    list->arcs[list->count++] = (arc_t){to, w};
+    return 1;
+}
+
+// Adds u->x, or lowers its weight if the pair already has an edge.
+static int set_arc(builder_t *b, int u, int x, double w) {
+    arc_list_t *out = &b->out[u];
+    for (int i = 0; i < out->count; ++i) {
+        if (out->arcs[i].to != x) continue;
+        if (w < out->arcs[i].w) {
+            out->arcs[i].w = w;
+            arc_list_t *in = &b->in[x];
+            for (int j = 0; j < in->count; ++j) {
+                if (in->arcs[j].to == u) { in->arcs[j].w = w; break; }
+            }
+        }
+        return 1;
+    }
+    return arc_push(out, x, w) && arc_push(&b->in[x], u, w);
+}
+
+static void arc_remove(arc_list_t *list, int to) {
+    for (int i = 0; i < list->count; ++i) {
+        if (list->arcs[i].to == to) { list->arcs[i] = list->arcs[--list->count]; return; }
+    }
+}
+
+static int push_grow(heap_item_t **heap, int *size, int *space, heap_item_t item) {
+    if (*size == *space) {
+        int grown_space = *space ? *space * 2 : 64;
+        heap_item_t *grown = realloc(*heap, sizeof(heap_item_t) * grown_space);
+        if (!grown) return 0;
+        *heap = grown;
+        *space = grown_space;
+    }
+    heapPush(*heap, size, item);
+    return 1;
+}
+
+static double witness_dist(const builder_t *b, int x) {
+    return b->stamp[x] == b->epoch ? b->dist[x] : INFINITY;
+}
+
+/*
+ * Dijkstra from source over the remaining nodes, avoiding skip, until
+ * the next key exceeds limit or CH_WITNESS_SETTLE_LIMIT nodes are
+ * settled. Tentative distances are real path lengths too, so callers
+ * may use witness_dist() for any node the search reached.
+ */
+static int witness_search(builder_t *b, int source, int skip, double limit) {
+    if (++b->epoch == 0) {
+        memset(b->stamp, 0, sizeof(unsigned) * b->n);
+        b->epoch = 1;
+    }
+    int size = 0, settled = 0;
+    b->stamp[source] = b->epoch;
+    b->dist[source] = 0.0;
+    if (!push_grow(&b->heap, &size, &b->heapSpace, (heap_item_t){source, 0.0})) return 0;
+
+    while (size > 0 && settled < b->settleLimit) {
+        heap_item_t it = heapPop(b->heap, &size);
+        if (it.dist > limit) break;
+        if (it.dist > b->dist[it.idx]) continue;
+        settled++;
+        const arc_list_t *out = &b->out[it.idx];
+        for (int i = 0; i < out->count; ++i) {
+            int x = out->arcs[i].to;
+            if (x == skip) continue;
+            double alt = it.dist + out->arcs[i].w;
+            if (alt < witness_dist(b, x)) {
+                b->stamp[x] = b->epoch;
+                b->dist[x] = alt;
+                if (!push_grow(&b->heap, &size, &b->heapSpace, (heap_item_t){x, alt})) return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/*
+ * Contracts v, or with simulate only counts the shortcuts it would
+ * add. Returns the count, or -1 if memory allocation fails.
+ */
+static int contract(builder_t *b, int v, int simulate) {
+    int added = 0;
+    b->settleLimit = simulate ? CH_SIMULATE_SETTLE_LIMIT : CH_WITNESS_SETTLE_LIMIT;
+    for (int i = 0; i < b->in[v].count; ++i) {
+        int u = b->in[v].arcs[i].to;
+        double w1 = b->in[v].arcs[i].w;
+
+        double limit = -1.0;
+        for (int j = 0; j < b->out[v].count; ++j) {
+            int x = b->out[v].arcs[j].to;
+            if (x == u) continue;
+            if (w1 + b->out[v].arcs[j].w > limit) limit = w1 + b->out[v].arcs[j].w;
+        }
+        if (limit < 0.0) continue;
+        if (!witness_search(b, u, v, limit)) return -1;
+
+        for (int j = 0; j < b->out[v].count; ++j) {
+            int x = b->out[v].arcs[j].to;
+            double w = w1 + b->out[v].arcs[j].w;
+            if (x == u || witness_dist(b, x) <= w) continue;
+            added++;
+            if (!simulate && !set_arc(b, u, x, w)) return -1;
+        }
+    }
+    if (!simulate) b->shortcuts += added;
+    return added;
+}
+
+// Edge difference plus contracted neighbours; lower contracts first.
+static int priority(builder_t *b, int v, double *out) {
+    int added = contract(b, v, 1);
+    if (added < 0) return 0;
+    *out = (double) added - (b->out[v].count + b->in[v].count) + b->deleted[v];
+    return 1;
+}
+
+static void builder_free(builder_t *b) {
+    if (b->out) for (int i = 0; i < b->n; ++i) free(b->out[i].arcs);
+    if (b->in) for (int i = 0; i < b->n; ++i) free(b->in[i].arcs);
+    free(b->out);
+    free(b->in);
+    free(b->contracted);
+    free(b->deleted);
+    free(b->dist);
+    free(b->stamp);
+    free(b->heap);
+}
+
+// Packs the frozen edge lists into the upward and downward CSR graphs.
+static int pack_lists(const builder_t *b, city_hierarchy_t *ch) {
+    int n = b->n;
+    ch->upOffsets = malloc(sizeof(int32_t) * (n + 1));
+    ch->downOffsets = malloc(sizeof(int32_t) * (n + 1));
+    if (!ch->upOffsets || !ch->downOffsets) return 0;
+
+    int up = 0, down = 0;
+    for (int u = 0; u < n; ++u) {
+        ch->upOffsets[u] = up;
+        ch->downOffsets[u] = down;
+        up += b->out[u].count;
+        down += b->in[u].count;
+    }
+    ch->upOffsets[n] = up;
+    ch->downOffsets[n] = down;
+    ch->upCount = up;
+    ch->downCount = down;
+
+    ch->upTargets = malloc(sizeof(int32_t) * (up + 1));
+    ch->upWeights = malloc(sizeof(double) * (up + 1));
+    ch->downSources = malloc(sizeof(int32_t) * (down + 1));
+    ch->downWeights = malloc(sizeof(double) * (down + 1));
+    if (!ch->upTargets || !ch->upWeights || !ch->downSources || !ch->downWeights) return 0;
+
+    up = down = 0;
+    for (int u = 0; u < n; ++u) {
+        for (int i = 0; i < b->out[u].count; ++i, ++up) {
+            ch->upTargets[up] = b->out[u].arcs[i].to;
+            ch->upWeights[up] = b->out[u].arcs[i].w;
+        }
+        for (int i = 0; i < b->in[u].count; ++i, ++down) {
+            ch->downSources[down] = b->in[u].arcs[i].to;
+            ch->downWeights[down] = b->in[u].arcs[i].w;
+        }
+    }
+    return 1;
+}
+
+int buildHierarchy(const csr_graph_t* net, city_hierarchy_t* ch) {
+    memset(ch, 0, sizeof(*ch));
+    if (!net) return 0;
+    int n = net->nodeCount;
+
+    builder_t b;
+    memset(&b, 0, sizeof(b));
+    b.n = n;
+    b.out = calloc(n + 1, sizeof(arc_list_t));
+    b.in = calloc(n + 1, sizeof(arc_list_t));
+    b.contracted = calloc(n + 1, 1);
+    b.deleted = calloc(n + 1, sizeof(int));
+    b.dist = malloc(sizeof(double) * (n + 1));
+    b.stamp = calloc(n + 1, sizeof(unsigned));
+    ch->rank = malloc(sizeof(int32_t) * (n + 1));
+    int ok = b.out && b.in && b.contracted && b.deleted && b.dist && b.stamp && ch->rank;
+
+    for (int u = 0; ok && u < n; ++u) {
+        for (int k = net->offsets[u]; ok && k < net->offsets[u + 1]; ++k) {
+            int x = net->targets[k];
+            if (x == u || isnan(net->weights[k])) continue;
+            ok = set_arc(&b, u, x, (double) net->weights[k]);
+        }
+    }
+
+    /*
+     * prio[v] is v's current priority; queue entries with another key
+     * are stale. Contracting v changes its neighbours' priorities, so
+     * they are recomputed right away (once each; updated[x] == v + 1
+     * marks those done). Contractions further away can change a
+     * priority too; that is ignored, as it only affects the order.
+     */
+    double *prio = malloc(sizeof(double) * (n + 1));
+    int *updated = calloc(n + 1, sizeof(int));
+    heap_item_t *queue = NULL;
+    int size = 0, space = 0;
+    ok = ok && prio && updated;
+    for (int v = 0; ok && v < n; ++v) {
+        ok = priority(&b, v, &prio[v]) && push_grow(&queue, &size, &space, (heap_item_t){v, prio[v]});
+    }
+    int order = 0;
+    while (ok && size > 0) {
+        heap_item_t it = heapPop(queue, &size);
+        int v = it.idx;
+        if (b.contracted[v] || it.dist != prio[v]) continue;
+        if (!(ok = contract(&b, v, 0) >= 0)) break;
+        b.contracted[v] = 1;
+        ch->rank[v] = order++;
+        for (int i = 0; i < b.out[v].count; ++i) arc_remove(&b.in[b.out[v].arcs[i].to], v);
+        for (int i = 0; i < b.in[v].count; ++i) arc_remove(&b.out[b.in[v].arcs[i].to], v);
+        for (int pass = 0; ok && pass < 2; ++pass) {
+            const arc_list_t *list = pass ? &b.in[v] : &b.out[v];
+            for (int i = 0; ok && i < list->count; ++i) {
+                int x = list->arcs[i].to;
+                if (updated[x] == v + 1) continue;
+                updated[x] = v + 1;
+                b.deleted[x]++;
+                ok = priority(&b, x, &prio[x]) && push_grow(&queue, &size, &space, (heap_item_t){x, prio[x]});
+            }
+        }
+    }
+    free(queue);
+    free(prio);
+    free(updated);
+
+    ok = ok && order == n && pack_lists(&b, ch);
+    ch->nodeCount = n;
+    ch->shortcuts = b.shortcuts;
+    builder_free(&b);
+    if (!ok) { freeHierarchy(ch); return 0; }
+    return 1;
+}
+
+void freeHierarchy(city_hierarchy_t* ch) {
+    if (!ch) return;
+    free(ch->rank);
+    free(ch->upOffsets);
+    free(ch->upTargets);
+    free(ch->upWeights);
+    free(ch->downOffsets);
+    free(ch->downSources);
+    free(ch->downWeights);
+    memset(ch, 0, sizeof(*ch));
+}
+
+/*
+ * Both searches only climb in rank, so the shortest path is found at
+ * its highest node, where they meet. A side stops once its smallest
+ * key reaches the best meeting distance; the other may still improve it.
+ */
+double hierarchyDistance(const city_t* city, search_workspace_t* ws, int sIndex, int tIndex, int* settled) {
+    if (settled) *settled = 0;
+    if (!city || !city->ch.nodeCount || sIndex < 0 || tIndex < 0) return INFINITY;
+    const city_hierarchy_t *ch = &city->ch;
+    if (!workspaceReset(ws, ch->nodeCount)) return INFINITY;
+
+    const int32_t *offsets[2] = {ch->upOffsets, ch->downOffsets};
+    const int32_t *ends[2] = {ch->upTargets, ch->downSources};
+    const double *weights[2] = {ch->upWeights, ch->downWeights};
+    unsigned int epoch = ws->epoch;
+    int count = 0;
+    int ok = workspacePush(ws, 0, sIndex, 0.0, 0.0) && workspacePush(ws, 1, tIndex, 0.0, 0.0);
+    double best = INFINITY;
+
+    while (ok && (workspaceQueued(ws, 0) > 0 || workspaceQueued(ws, 1) > 0)) {
+        int d = workspaceQueued(ws, 1) == 0 || (workspaceQueued(ws, 0) > 0 && workspaceTop(ws, 0) <= workspaceTop(ws, 1)) ? 0 : 1;
+        if (workspaceTop(ws, d) >= best) { workspaceClear(ws, d); continue; }
+        int u = workspacePop(ws, d).idx;
+        if (ws->settled[d][u] == epoch) continue;
+        ws->settled[d][u] = epoch;
+        count++;
+        double through = ws->dist[d][u] + workspaceDist(ws, 1 - d, u);
+        if (through < best) best = through;
+
+        for (int k = offsets[d][u]; k < offsets[d][u + 1] && ok; ++k) {
+            int v = ends[d][k];
+            double alt = ws->dist[d][u] + weights[d][k];
+            if (alt < workspaceDist(ws, d, v)) ok = workspacePush(ws, d, v, alt, alt);
+        }
+    }
+
+    if (settled) *settled = count;
+    return ok ? best : INFINITY;
+}
@@ -0,0 +1,42 @@
+#ifndef CH_H
+#define CH_H
+
+#include <stdint.h>
+#include "graph.h"
+#include "city.h"
+#include "workspace.h"
+
+#define CH_WITNESS_SETTLE_LIMIT 500
+#define CH_SIMULATE_SETTLE_LIMIT 50
+
+/**
+* Builds a contraction hierarchy for net. Nodes are ordered by edge
+* difference (shortcuts added minus edges removed) plus the number of
+* already contracted neighbours; a contraction updates its neighbours'
+* priorities. Witness searches settle at most CH_WITNESS_SETTLE_LIMIT
+* nodes (CH_SIMULATE_SETTLE_LIMIT when only estimating a priority); a
+* search that gives up only costs an unneeded shortcut, never a wrong
+* distance.
+* Edges with NaN weights are left out, as Dijkstra never uses them.
+* @return 1 on success, 0 if memory allocation fails.
+**/
+int buildHierarchy(const csr_graph_t* net, city_hierarchy_t* ch);
+
+/**
+* Frees the arrays of a hierarchy built by buildHierarchy().
+**/
+void freeHierarchy(city_hierarchy_t* ch);
+
+/**
+* Shortest road distance through the city's hierarchy (see
+* cityAddHierarchy()): a forward search from sIndex over the upward
+* graph and a backward search from tIndex over the downward graph.
+* Distances equal Dijkstra's up to floating-point summation order.
+* All scratch memory comes from ws (see routeQuery()).
+* @param settled If not NULL, receives the number of nodes settled.
+* @return The distance in meters, or INFINITY if tIndex is unreachable,
+* the city has no hierarchy or memory allocation fails.
+**/
+double hierarchyDistance(const city_t* city, search_workspace_t* ws, int sIndex, int tIndex, int* settled);
+
+#endif
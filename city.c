@@ -0,0 +1,713 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <math.h>
+#include "city.h"
+#include "ch.h"
+#include "geo.h"
+#include "spatial.h"
+#include "strpool.h"
+#include "testgraph.h"
+
+#define SNAPSHOT_MAGIC "RFCITY\0\0"
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+
+enum {
+    SEC_IDS,
+    SEC_OFFSETS,
+    SEC_TARGETS,
+    SEC_WEIGHTS,
+    SEC_POIS,
+    SEC_ROAD_NAMES,
+    SEC_STRINGS,
+    SEC_NAME_INDEX,
+    SEC_SORTED_NAMES,
+    SEC_REV_OFFSETS,
+    SEC_REV_SOURCES,
+    SEC_REV_WEIGHTS,
+    SEC_SPATIAL,
+    SEC_CH_RANK,
+    SEC_CH_UP_OFFSETS,
+    SEC_CH_UP_TARGETS,
+    SEC_CH_UP_WEIGHTS,
+    SEC_CH_DOWN_OFFSETS,
+    SEC_CH_DOWN_SOURCES,
+    SEC_CH_DOWN_WEIGHTS,
+    SECTION_COUNT
+};
+
+/*
+ * Snapshot header. All sections follow it in the same file, each at an
+ * 8-byte aligned offset recorded in sections[]. Integers are in host
+ * byte order; byteOrder lets a reader reject a file from another host.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    int32_t nodeCount;
+    int32_t edgeCount;
+    uint32_t stringsSize;
+    uint32_t nameSlots;
+    uint32_t sortedNameCount;
+    uint32_t hasHierarchy;
+    int32_t chUpCount;
+    int32_t chDownCount;
+    int32_t chShortcuts;
+    uint32_t spatialCount;
+    uint64_t imageSize;
+    double heuristicScale;
+    uint64_t sections[SECTION_COUNT];
+} snapshot_header_t;
+
+graph_t* buildGraphFromFile(FILE *fp, strpool_t *names) {
+    if (!fp) return NULL;
+    graph_t *g = createGraph();
+    if (!g) return NULL;
+
+    int numPOI = 0;
+    if (fscanf(fp, "%d", &numPOI) != 1 || numPOI <= 0) {
+        freeGraph(g);
+        return NULL;
+    }
+
+    int ch = fgetc(fp);
+    if (ch != '\n' && ch != EOF) ungetc(ch, fp);
+
+    for (int i = 0; i < numPOI; ++i) {
+        char line[1024];
+        if (!fgets(line, sizeof(line), fp)) { freeGraph(g); return NULL; }
+
+        char name[256];
+        int id;
+        double lat, lon;
+
+        char *p = line;
+        if (sscanf(p, "%d", &id) != 1) { freeGraph(g); return NULL; }
+
+        char *tab1 = strchr(p, '\t');
+        if (!tab1) { freeGraph(g); return NULL; }
+        tab1++;
+
+        char *tab2 = strchr(tab1, '\t');
+        if (!tab2) { freeGraph(g); return NULL; }
+
+        size_t namelen = tab2 - tab1;
+        if (namelen >= sizeof(name)) namelen = sizeof(name)-1;
+        memcpy(name, tab1, namelen);
+        name[namelen] = '\0';
+
+        if (sscanf(tab2+1, "%lf\t%lf", &lat, &lon) != 2) { freeGraph(g); return NULL; }
+
+        POIData *poi = graphAlloc(g, sizeof(POIData));
+        if (!poi) { freeGraph(g); return NULL; }
+        poi->name = strpoolIntern(names, name);
+        if (poi->name == STRPOOL_NONE) { freeGraph(g); return NULL; }
+        poi->lat = lat;
+        poi->lon = lon;
+
+        if (!addNode(g, id, poi)) {
+            freeGraph(g);
+            return NULL;
+        }
+    }
+
+    int numRoads = 0;
+    if (fscanf(fp, "%d", &numRoads) != 1 || numRoads <= 0) {
+        freeGraph(g);
+        return NULL;
+    }
+
+    ch = fgetc(fp);
+    if (ch != '\n' && ch != EOF) ungetc(ch, fp);
+
+    for (int i = 0; i < numRoads; ++i) {
+        char line[1024];
+        if (!fgets(line, sizeof(line), fp)) { freeGraph(g); return NULL; }
+
+        int fromId, toId;
+        char dist_token[64];
+        double lat, lon;
+        char roadName[256];
+
+        char *p = line;
+        char *tab1 = strchr(p, '\t');
+        if (!tab1) { freeGraph(g); return NULL; }
+        *tab1 = '\0';
+        fromId = atoi(p);
+        p = tab1 + 1;
+
+        char *tab2 = strchr(p, '\t');
+        if (!tab2) { freeGraph(g); return NULL; }
+        *tab2 = '\0';
+        toId = atoi(p);
+        p = tab2 + 1;
+
+        char *tab3 = strchr(p, '\t');
+        if (!tab3) { freeGraph(g); return NULL; }
+        *tab3 = '\0';
+        strncpy(dist_token, p, sizeof(dist_token)-1);
+        dist_token[sizeof(dist_token)-1] = '\0';
+        p = tab3 + 1;
+
+        char *tab4 = strchr(p, '\t');
+        if (!tab4) { freeGraph(g); return NULL; }
+        *tab4 = '\0';
+        if (sscanf(p, "%lf", &lat) != 1) { freeGraph(g); return NULL; }
+        p = tab4 + 1;
+
+        char *tab5 = strchr(p, '\t');
+        if (!tab5) { freeGraph(g); return NULL; }
+        *tab5 = '\0';
+        if (sscanf(p, "%lf", &lon) != 1) { freeGraph(g); return NULL; }
+        p = tab5 + 1;
+
+        char *newline = strchr(p, '\n');
+        if (newline) *newline = '\0';
+        strncpy(roadName, p, sizeof(roadName)-1);
+        roadName[sizeof(roadName)-1] = '\0';
+
+        float distVal = 0.0f;
+        if (strcmp(dist_token, "NaN") != 0) {
+            double tmp;
+            if (sscanf(dist_token, "%lf", &tmp) == 1) distVal = (float)tmp;
+            else { freeGraph(g); return NULL; }
+        } else {
+            distVal = 0.0f;
+        }
+
+        RoadData *rd = graphAlloc(g, sizeof(RoadData));
+        if (!rd) { freeGraph(g); return NULL; }
+        rd->roadName = strpoolIntern(names, roadName);
+        if (rd->roadName == STRPOOL_NONE) { freeGraph(g); return NULL; }
+
+        if (!addEdge(g, fromId, toId, distVal, rd)) {
+            freeGraph(g);
+            return NULL;
+        }
+    }
+
+    return g;
+}
+
+static uint64_t align8(uint64_t x) {
+    return (x + 7) & ~(uint64_t) 7;
+}
+
+static void plan_layout(snapshot_header_t *h) {
+    uint64_t n = (uint64_t) h->nodeCount;
+    uint64_t m = (uint64_t) h->edgeCount;
+    uint64_t sizes[SECTION_COUNT];
+    sizes[SEC_IDS] = n * sizeof(int32_t);
+    sizes[SEC_OFFSETS] = (n + 1) * sizeof(int32_t);
+    sizes[SEC_TARGETS] = m * sizeof(int32_t);
+    sizes[SEC_WEIGHTS] = m * sizeof(float);
+    sizes[SEC_POIS] = n * sizeof(city_poi_t);
+    sizes[SEC_ROAD_NAMES] = m * sizeof(uint32_t);
+    sizes[SEC_STRINGS] = h->stringsSize;
+    sizes[SEC_NAME_INDEX] = (uint64_t) h->nameSlots * sizeof(city_name_slot_t);
+    sizes[SEC_SORTED_NAMES] = (uint64_t) h->sortedNameCount * sizeof(uint32_t);
+    sizes[SEC_REV_OFFSETS] = (n + 1) * sizeof(int32_t);
+    sizes[SEC_REV_SOURCES] = m * sizeof(int32_t);
+    sizes[SEC_REV_WEIGHTS] = m * sizeof(float);
+    sizes[SEC_SPATIAL] = (uint64_t) h->spatialCount * sizeof(city_spatial_point_t);
+
+    // The hierarchy sections come last and are empty without one, so
+    // adding a hierarchy leaves every other section where it was.
+    uint64_t chNodes = h->hasHierarchy ? n : 0;
+    uint64_t up = h->hasHierarchy ? (uint64_t) h->chUpCount : 0;
+    uint64_t down = h->hasHierarchy ? (uint64_t) h->chDownCount : 0;
+    sizes[SEC_CH_RANK] = chNodes * sizeof(int32_t);
+    sizes[SEC_CH_UP_OFFSETS] = (chNodes + !!chNodes) * sizeof(int32_t);
+    sizes[SEC_CH_UP_TARGETS] = up * sizeof(int32_t);
+    sizes[SEC_CH_UP_WEIGHTS] = up * sizeof(double);
+    sizes[SEC_CH_DOWN_OFFSETS] = (chNodes + !!chNodes) * sizeof(int32_t);
+    sizes[SEC_CH_DOWN_SOURCES] = down * sizeof(int32_t);
+    sizes[SEC_CH_DOWN_WEIGHTS] = down * sizeof(double);
+
+    uint64_t at = align8(sizeof(snapshot_header_t));
+    for (int s = 0; s < SECTION_COUNT; ++s) {
+        h->sections[s] = at;
+        at = align8(at + sizes[s]);
+    }
+    h->imageSize = at;
+}
+
+/*
+ * Points the city's arrays into an image. The header and section table
+ * are checked; the section contents are trusted, since snapshots are
+ * only produced by writeCitySnapshot().
+ */
+static int city_attach(city_t *city, void *image, size_t size) {
+    const snapshot_header_t *h = image;
+    if (size < sizeof(snapshot_header_t)) return 0;
+    if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) != 0) return 0;
+    if (h->version != CITY_SNAPSHOT_VERSION || h->byteOrder != SNAPSHOT_BYTE_ORDER) return 0;
+    if (h->nodeCount < 0 || h->edgeCount < 0 || h->imageSize != size) return 0;
+    if (h->stringsSize == 0) return 0;
+    if (h->nameSlots == 0 || (h->nameSlots & (h->nameSlots - 1)) != 0) return 0;
+    if (h->sortedNameCount > (uint32_t) h->nodeCount) return 0;
+    if (h->spatialCount > (uint32_t) h->nodeCount) return 0;
+    if (!(h->heuristicScale >= 0.0 && h->heuristicScale <= 1.0)) return 0;
+    if (h->hasHierarchy > 1 || h->chUpCount < 0 || h->chDownCount < 0) return 0;
+
+    snapshot_header_t expect = *h;
+    plan_layout(&expect);
+    if (memcmp(expect.sections, h->sections, sizeof(h->sections)) != 0) return 0;
+    if (expect.imageSize != h->imageSize) return 0;
+
+    char *base = image;
+    city->net.nodeCount = h->nodeCount;
+    city->net.edgeCount = h->edgeCount;
+    city->net.ids = (int*) (base + h->sections[SEC_IDS]);
+    city->net.offsets = (int*) (base + h->sections[SEC_OFFSETS]);
+    city->net.targets = (int*) (base + h->sections[SEC_TARGETS]);
+    city->net.weights = (float*) (base + h->sections[SEC_WEIGHTS]);
+    city->net.nodeData = NULL;
+    city->net.edgeData = NULL;
+    city->net.revOffsets = (int*) (base + h->sections[SEC_REV_OFFSETS]);
+    city->net.revSources = (int*) (base + h->sections[SEC_REV_SOURCES]);
+    city->net.revWeights = (float*) (base + h->sections[SEC_REV_WEIGHTS]);
+    city->pois = (const city_poi_t*) (base + h->sections[SEC_POIS]);
+    city->roadNames = (const uint32_t*) (base + h->sections[SEC_ROAD_NAMES]);
+    city->strings = base + h->sections[SEC_STRINGS];
+    city->stringsSize = h->stringsSize;
+    city->nameIndex = (const city_name_slot_t*) (base + h->sections[SEC_NAME_INDEX]);
+    city->nameSlots = h->nameSlots;
+    city->sortedNames = (const uint32_t*) (base + h->sections[SEC_SORTED_NAMES]);
+    city->sortedNameCount = h->sortedNameCount;
+    city->spatial = (const city_spatial_point_t*) (base + h->sections[SEC_SPATIAL]);
+    city->spatialCount = h->spatialCount;
+    city->heuristicScale = h->heuristicScale;
+    memset(&city->ch, 0, sizeof(city->ch));
+    if (h->hasHierarchy) {
+        city_hierarchy_t *ch = &city->ch;
+        ch->nodeCount = h->nodeCount;
+        ch->upCount = h->chUpCount;
+        ch->downCount = h->chDownCount;
+        ch->shortcuts = h->chShortcuts;
+        ch->rank = (int32_t*) (base + h->sections[SEC_CH_RANK]);
+        ch->upOffsets = (int32_t*) (base + h->sections[SEC_CH_UP_OFFSETS]);
+        ch->upTargets = (int32_t*) (base + h->sections[SEC_CH_UP_TARGETS]);
+        ch->upWeights = (double*) (base + h->sections[SEC_CH_UP_WEIGHTS]);
+        ch->downOffsets = (int32_t*) (base + h->sections[SEC_CH_DOWN_OFFSETS]);
+        ch->downSources = (int32_t*) (base + h->sections[SEC_CH_DOWN_SOURCES]);
+        ch->downWeights = (double*) (base + h->sections[SEC_CH_DOWN_WEIGHTS]);
+        if (ch->upOffsets[0] != 0 || ch->upOffsets[h->nodeCount] != ch->upCount) return 0;
+        if (ch->downOffsets[0] != 0 || ch->downOffsets[h->nodeCount] != ch->downCount) return 0;
+    }
+    city->image = image;
+    city->imageSize = size;
+
+    if (city->net.offsets[0] != 0 || city->net.offsets[h->nodeCount] != h->edgeCount) return 0;
+    if (city->net.revOffsets[0] != 0 || city->net.revOffsets[h->nodeCount] != h->edgeCount) return 0;
+    if (city->strings[h->stringsSize - 1] != '\0') return 0;
+    return 1;
+}
+
+// Names are interned, so a repeated name is recognised by its handle.
+static void index_name(city_name_slot_t *slots, uint32_t nslots, const strpool_t *names,
+                       uint32_t name, int node) {
+    uint32_t hash = strpoolHash(strpoolGet(names, name));
+    uint32_t mask = nslots - 1;
+    uint32_t i = hash & mask;
+    while (slots[i].node != -1) {
+        if (slots[i].name == name) return;
+        i = (i + 1) & mask;
+    }
+    slots[i].hash = hash;
+    slots[i].name = name;
+    slots[i].node = node;
+}
+
+/*
+ * Name search compares names case-insensitively (ASCII only), so the
+ * sorted name list is ordered by folded bytes, then by raw bytes so
+ * the order is total.
+ */
+static int fold(unsigned char c) {
+    return tolower(c);
+}
+
+static int fold_cmp(const char *a, const char *b) {
+    const unsigned char *x = (const unsigned char*) a, *y = (const unsigned char*) b;
+    while (*x && fold(*x) == fold(*y)) { x++; y++; }
+    if (fold(*x) != fold(*y)) return fold(*x) - fold(*y);
+    return strcmp(a, b);
+}
+
+typedef struct {
+    const char *s;
+    uint32_t handle;
+} name_ref_t;
+
+static int cmp_name_ref(const void *a, const void *b) {
+    return fold_cmp(((const name_ref_t*) a)->s, ((const name_ref_t*) b)->s);
+}
+
+// Fills out with the distinct POI name handles in fold_cmp() order.
+static int sort_names(uint32_t *out, uint32_t count, const unsigned char *seen, const strpool_t *names) {
+    name_ref_t *refs = malloc(sizeof(name_ref_t) * (count + 1));
+    if (!refs) return 0;
+    uint32_t n = 0;
+    for (uint32_t h = 0; h < names->size && n < count; ++h) {
+        if (seen[h >> 3] & (1u << (h & 7))) refs[n++] = (name_ref_t){strpoolGet(names, h), h};
+    }
+    qsort(refs, n, sizeof(name_ref_t), cmp_name_ref);
+    for (uint32_t i = 0; i < n; ++i) out[i] = refs[i].handle;
+    free(refs);
+    return 1;
+}
+
+/*
+ * Largest s <= 1 such that s * haversine() never exceeds an edge's
+ * weight, which makes s * haversine(v, t) a consistent A* heuristic.
+ * Edges with NaN weights are never relaxed, so they do not count.
+ */
+static double heuristic_scale(const int32_t *offsets, const int32_t *targets,
+                              const float *weights, const city_poi_t *pois, int n) {
+    double scale = 1.0;
+    for (int u = 0; u < n; ++u) {
+        for (int k = offsets[u]; k < offsets[u + 1]; ++k) {
+            const city_poi_t *a = &pois[u], *b = &pois[targets[k]];
+            double straight = haversine(a->lat, a->lon, b->lat, b->lon);
+            if (isnan(weights[k]) || !(straight > 0.0)) continue;
+            if (weights[k] < scale * straight) scale = weights[k] / straight;
+        }
+    }
+    // Leave room for rounding in haversine() and the float weights.
+    scale *= 1.0 - 1e-6;
+    return scale > 0.0 ? scale : 0.0;
+}
+
+city_t* cityFromGraph(graph_t* graph, const strpool_t* names) {
+    if (!graph || !names) return NULL;
+
+    int edges = 0;
+    for (int i = 0; i < graph->nodeCount; ++i) {
+        for (edge_t *e = graph->nodes[i]->edges; e; e = e->next) edges++;
+    }
+
+    // One bit per string-table byte marks the handles used by POIs.
+    uint32_t distinct = 0;
+    unsigned char *seen = calloc(names->size / 8 + 1, 1);
+    if (!seen) return NULL;
+    for (int i = 0; i < graph->nodeCount; ++i) {
+        uint32_t h = ((POIData*) graph->nodes[i]->data)->name;
+        if (!(seen[h >> 3] & (1u << (h & 7)))) {
+            seen[h >> 3] |= (unsigned char) (1u << (h & 7));
+            distinct++;
+        }
+    }
+
+    snapshot_header_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.version = CITY_SNAPSHOT_VERSION;
+    h.byteOrder = SNAPSHOT_BYTE_ORDER;
+    h.nodeCount = graph->nodeCount;
+    h.edgeCount = edges;
+    h.stringsSize = names->size;
+    h.nameSlots = 16;
+    while (h.nameSlots < 2u * (uint32_t) graph->nodeCount) h.nameSlots *= 2;
+    h.sortedNameCount = distinct;
+    for (int i = 0; i < graph->nodeCount; ++i) {
+        POIData *poi = (POIData*) graph->nodes[i]->data;
+        if (isfinite(poi->lat) && isfinite(poi->lon)) h.spatialCount++;
+    }
+    plan_layout(&h);
+
+    city_t *city = calloc(1, sizeof(city_t));
+    char *image = calloc(1, h.imageSize);
+    if (!city || !image ||
+        !sort_names((uint32_t*) (image + h.sections[SEC_SORTED_NAMES]), distinct, seen, names)) {
+        free(city); free(image); free(seen);
+        return NULL;
+    }
+    free(seen);
+    memcpy(image, &h, sizeof(h));
+
+    // Same node numbering and edge order as freezeGraph(). The string
+    // table is the pool itself, so name offsets are the pool handles.
+    int32_t *ids = (int32_t*) (image + h.sections[SEC_IDS]);
+    int32_t *offsets = (int32_t*) (image + h.sections[SEC_OFFSETS]);
+    int32_t *targets = (int32_t*) (image + h.sections[SEC_TARGETS]);
+    float *weights = (float*) (image + h.sections[SEC_WEIGHTS]);
+    city_poi_t *pois = (city_poi_t*) (image + h.sections[SEC_POIS]);
+    uint32_t *roadNames = (uint32_t*) (image + h.sections[SEC_ROAD_NAMES]);
+    city_name_slot_t *slots = (city_name_slot_t*) (image + h.sections[SEC_NAME_INDEX]);
+    memcpy(image + h.sections[SEC_STRINGS], names->chars, names->size);
+    for (uint32_t i = 0; i < h.nameSlots; ++i) slots[i].node = -1;
+
+    int k = 0;
+    for (int i = 0; i < graph->nodeCount; ++i) {
+        node_t *node = graph->nodes[i];
+        POIData *poi = (POIData*) node->data;
+        ids[i] = node->id;
+        offsets[i] = k;
+        pois[i].lat = poi->lat;
+        pois[i].lon = poi->lon;
+        pois[i].name = poi->name;
+        index_name(slots, h.nameSlots, names, poi->name, i);
+        for (edge_t *e = node->edges; e; e = e->next, ++k) {
+            targets[k] = e->toNode->index;
+            weights[k] = e->weight;
+            roadNames[k] = ((RoadData*) e->data)->roadName;
+        }
+    }
+    offsets[graph->nodeCount] = k;
+    csrReverse(h.nodeCount, offsets, targets, weights, (int32_t*) (image + h.sections[SEC_REV_OFFSETS]),
+               (int32_t*) (image + h.sections[SEC_REV_SOURCES]), (float*) (image + h.sections[SEC_REV_WEIGHTS]));
+    ((snapshot_header_t*) image)->heuristicScale = heuristic_scale(offsets, targets, weights, pois, h.nodeCount);
+    spatialBuild(pois, h.nodeCount, (city_spatial_point_t*) (image + h.sections[SEC_SPATIAL]));
+
+    if (!city_attach(city, image, h.imageSize)) { free(image); free(city); return NULL; }
+    return city;
+}
+
+static city_t* map_snapshot(const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(snapshot_header_t)) { close(fd); return NULL; }
+
+    void *image = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) return NULL;
+
+    city_t *city = calloc(1, sizeof(city_t));
+    if (!city || !city_attach(city, image, (size_t) st.st_size)) {
+        free(city);
+        munmap(image, (size_t) st.st_size);
+        return NULL;
+    }
+    city->mapped = 1;
+    return city;
+}
+
+city_t* loadCity(const char* filename) {
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) return NULL;
+
+    char magic[8];
+    if (fread(magic, 1, sizeof(magic), fp) == sizeof(magic) &&
+        memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0) {
+        fclose(fp);
+        return map_snapshot(filename);
+    }
+    rewind(fp);
+
+    strpool_t *names = createStrPool();
+    graph_t *graph = names ? buildGraphFromFile(fp, names) : NULL;
+    fclose(fp);
+    if (!graph) { freeStrPool(names); return NULL; }
+
+    city_t *city = cityFromGraph(graph, names);
+    freeGraph(graph);
+    freeStrPool(names);
+    return city;
+}
+
+int cityFindNode(const city_t* city, const char* name) {
+    if (!city || !name) return -1;
+    uint32_t hash = strpoolHash(name);
+    uint32_t mask = city->nameSlots - 1;
+    uint32_t i = hash & mask;
+    while (city->nameIndex[i].node != -1) {
+        const city_name_slot_t *slot = &city->nameIndex[i];
+        if (slot->hash == hash && strcmp(city->strings + slot->name, name) == 0)
+            return slot->node;
+        i = (i + 1) & mask;
+    }
+    return -1;
+}
+
+// Compares the first len folded bytes of name against prefix (already folded).
+static int fold_prefix_cmp(const char *name, const char *prefix, int len) {
+    for (int i = 0; i < len; ++i) {
+        int a = fold((unsigned char) name[i]);
+        int b = (unsigned char) prefix[i];
+        if (a != b) return a - b;
+        if (!a) return 0;
+    }
+    return 0;
+}
+
+// First sorted position at or after lo whose folded prefix of length len is >= prefix
+// (upper = 0) or > prefix (upper = 1).
+static uint32_t prefix_bound(const city_t *city, uint32_t lo, const char *prefix, int len, int upper) {
+    uint32_t hi = city->sortedNameCount;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int c = fold_prefix_cmp(city->strings + city->sortedNames[mid], prefix, len);
+        if (c < 0 || (upper && c == 0)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+typedef struct {
+    int score;
+    uint32_t pos;
+} search_hit_t;
+
+static int add_hit(search_hit_t *hits, int count, int k, int score, uint32_t pos) {
+    if (count == k && hits[k - 1].score <= score) return count;
+    int i = count < k ? count++ : k - 1;
+    while (i > 0 && hits[i - 1].score > score) {
+        hits[i] = hits[i - 1];
+        i--;
+    }
+    hits[i] = (search_hit_t){score, pos};
+    return count;
+}
+
+int citySearchNames(const city_t* city, const char* query, int k, uint32_t* out) {
+    if (!city || !query || k <= 0 || city->sortedNameCount == 0) return 0;
+
+    char q[CITY_SEARCH_MAX_QUERY + 1];
+    int qlen = 0;
+    while (query[qlen] && qlen < CITY_SEARCH_MAX_QUERY) {
+        q[qlen] = (char) fold((unsigned char) query[qlen]);
+        qlen++;
+    }
+    q[qlen] = '\0';
+
+    // Exact prefix matches come first and in order, so a full page of
+    // them needs nothing beyond two binary searches.
+    uint32_t first = prefix_bound(city, 0, q, qlen, 0);
+    uint32_t last = prefix_bound(city, first, q, qlen, 1);
+    if (last - first >= (uint32_t) k) {
+        for (int i = 0; i < k; ++i) out[i] = city->sortedNames[first + i];
+        return k;
+    }
+
+    /*
+     * Fuzzy pass: walk the sorted names as if they were a trie. rows[d]
+     * is the edit-distance row of the query against the name's first d
+     * (folded) bytes, shared with the previous name up to their common
+     * prefix. A name scores the best distance between the query and any
+     * of its prefixes. Once every entry of a row exceeds the bound, no
+     * name with that prefix can match and the whole range is skipped.
+     */
+    int maxEdits = qlen <= 4 ? 1 : CITY_SEARCH_MAX_EDITS;
+    search_hit_t *hits = malloc(sizeof(search_hit_t) * k);
+    int (*rows)[CITY_SEARCH_MAX_QUERY + 1] = malloc(sizeof(*rows) * (CITY_SEARCH_MAX_DEPTH + 1));
+    char *path = malloc(CITY_SEARCH_MAX_DEPTH + 1);
+    if (!hits || !rows || !path) { free(hits); free(rows); free(path); return 0; }
+
+    for (int j = 0; j <= qlen; ++j) rows[0][j] = j;
+    int count = 0;
+    int valid = 0;
+    uint32_t pos = 0;
+    while (pos < city->sortedNameCount) {
+        const char *name = city->strings + city->sortedNames[pos];
+        int bound = (count == k) ? hits[k - 1].score - 1 : maxEdits;
+        if (bound < 0) break;
+
+        int d = 0;
+        while (d < valid && name[d] && fold((unsigned char) name[d]) == (unsigned char) path[d]) d++;
+
+        int best = rows[d][qlen];
+        for (int e = 1; e <= d; ++e) if (rows[e][qlen] < best) best = rows[e][qlen];
+        int pruned = 0;
+        while (name[d] && d < CITY_SEARCH_MAX_DEPTH && best > 0) {
+            int c = fold((unsigned char) name[d]);
+            int *prev = rows[d], *row = rows[d + 1];
+            path[d] = (char) c;
+            row[0] = d + 1;
+            int rowMin = row[0];
+            for (int j = 1; j <= qlen; ++j) {
+                int sub = prev[j - 1] + ((unsigned char) q[j - 1] != c);
+                int del = prev[j] + 1;
+                int ins = row[j - 1] + 1;
+                int v = sub < del ? sub : del;
+                row[j] = v < ins ? v : ins;
+                if (row[j] < rowMin) rowMin = row[j];
+            }
+            d++;
+            if (row[qlen] < best) best = row[qlen];
+            if (rowMin > bound) { pruned = 1; break; }
+        }
+        valid = d;
+
+        if (pruned && best > bound) {
+            pos = prefix_bound(city, pos + 1, path, d, 1);
+            continue;
+        }
+        if (best <= bound) count = add_hit(hits, count, k, best, pos);
+        pos++;
+    }
+
+    for (int i = 0; i < count; ++i) out[i] = city->sortedNames[hits[i].pos];
+    free(hits);
+    free(rows);
+    free(path);
+    return count;
+}
+
+int writeCitySnapshot(const city_t* city, const char* filename) {
+    if (!city) return 0;
+    FILE *fp = fopen(filename, "wb");
+    if (!fp) return 0;
+    size_t written = fwrite(city->image, 1, city->imageSize, fp);
+    if (fclose(fp) != 0 || written != city->imageSize) return 0;
+    return 1;
+}
+
+static void release_image(city_t *city) {
+    if (city->mapped) munmap(city->image, city->imageSize);
+    else free(city->image);
+}
+
+int cityAddHierarchy(city_t* city) {
+    if (!city) return 0;
+    if (city->ch.nodeCount) return 1;
+
+    city_hierarchy_t ch;
+    if (!buildHierarchy(&city->net, &ch)) return 0;
+
+    const snapshot_header_t *old = city->image;
+    snapshot_header_t h = *old;
+    h.hasHierarchy = 1;
+    h.chUpCount = ch.upCount;
+    h.chDownCount = ch.downCount;
+    h.chShortcuts = ch.shortcuts;
+    plan_layout(&h);
+
+    char *image = calloc(1, h.imageSize);
+    if (!image) { freeHierarchy(&ch); return 0; }
+    memcpy(image, &h, sizeof(h));
+    uint64_t at = old->sections[0];
+    memcpy(image + at, (const char*) city->image + at, old->sections[SEC_CH_RANK] - at);
+
+    int n = h.nodeCount;
+    memcpy(image + h.sections[SEC_CH_RANK], ch.rank, sizeof(int32_t) * n);
+    memcpy(image + h.sections[SEC_CH_UP_OFFSETS], ch.upOffsets, sizeof(int32_t) * (n + 1));
+    memcpy(image + h.sections[SEC_CH_UP_TARGETS], ch.upTargets, sizeof(int32_t) * ch.upCount);
+    memcpy(image + h.sections[SEC_CH_UP_WEIGHTS], ch.upWeights, sizeof(double) * ch.upCount);
+    memcpy(image + h.sections[SEC_CH_DOWN_OFFSETS], ch.downOffsets, sizeof(int32_t) * (n + 1));
+    memcpy(image + h.sections[SEC_CH_DOWN_SOURCES], ch.downSources, sizeof(int32_t) * ch.downCount);
+    memcpy(image + h.sections[SEC_CH_DOWN_WEIGHTS], ch.downWeights, sizeof(double) * ch.downCount);
+    freeHierarchy(&ch);
+
+    city_t updated;
+    memset(&updated, 0, sizeof(updated));
+    if (!city_attach(&updated, image, h.imageSize)) { free(image); return 0; }
+    release_image(city);
+    *city = updated;
+    return 1;
+}
+
+void freeCity(city_t* city) {
+    if (!city) return;
+    release_image(city);
+    free(city);
+}
@@ -0,0 +1,182 @@
+#ifndef CITY_H
+#define CITY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "graph.h"
+#include "strpool.h"
+
+#define CITY_SNAPSHOT_VERSION 7
+#define CITY_SEARCH_MAX_QUERY 64
+#define CITY_SEARCH_MAX_DEPTH 256
+#define CITY_SEARCH_MAX_EDITS 2
+
+/**
+* Per-node record of a loaded city.
+* name is a byte offset into the city's string table. Names are
+* deduplicated, so two nodes have the same name exactly when their
+* offsets are equal.
+**/
+typedef struct {
+    double lat;
+    double lon;
+    uint32_t name;
+    uint32_t reserved;
+} city_poi_t;
+
+/**
+* Slot of the name index: an open-addressing table keyed by
+* strpoolHash() of a POI name. node is the first node (lowest index)
+* with that name, or -1 for an empty slot.
+**/
+typedef struct {
+    uint32_t hash;
+    uint32_t name;
+    int32_t node;
+} city_name_slot_t;
+
+/**
+* Point of the spatial index: a POI's position as a unit vector (so
+* straight-line distances in xyz order POIs like haversine() does) and
+* its node. The points form an implicit k-d tree: the point in the
+* middle of any subtree range splits it along axis, with the lower
+* half before it and the upper half after it.
+**/
+typedef struct {
+    double xyz[3];
+    int32_t node;
+    int32_t axis;
+} city_spatial_point_t;
+
+/**
+* A contraction hierarchy over a road network, as built by
+* buildHierarchy() in ch.h. Nodes are contracted one at a time in
+* rank order; contracting v adds a shortcut u->x (weight w(u,v) + w(v,x)) for each
+* pair of its remaining neighbours unless a witness path avoiding v is
+* at least as short.
+* The upward graph holds, for each node u, the edges (original or
+* shortcut) u->x with rank[x] > rank[u]; the downward graph holds,
+* for each node x, the edges u->x with rank[u] > rank[x], listed by
+* their tail u. Both are CSR arrays like csr_graph_t. Weights are
+* doubles so that shortcut sums are not rounded to float.
+* nodeCount is 0 and the arrays NULL when there is no hierarchy.
+**/
+typedef struct {
+    int nodeCount;
+    int upCount;
+    int downCount;
+    int shortcuts;
+    int32_t* rank;
+    int32_t* upOffsets;
+    int32_t* upTargets;
+    double* upWeights;
+    int32_t* downOffsets;
+    int32_t* downSources;
+    double* downWeights;
+} city_hierarchy_t;
+
+/**
+* A read-only, fully packed city: the road network in CSR form plus
+* the POI records, road names and one string table holding every name.
+* Node i of net is described by pois[i]; edge k of net is named
+* strings + roadNames[k]. net.nodeData and net.edgeData are NULL; the
+* reverse adjacency of net is filled in, for backward searches.
+* nameIndex (nameSlots entries, a power of two) resolves a POI name
+* to its node without scanning. sortedNames lists each distinct POI
+* name once, ordered case-insensitively, for prefix and fuzzy search.
+* heuristicScale is the largest factor (at most 1) for which
+* heuristicScale * haversine() never overestimates a road distance;
+* it is 0 when some edge is shorter than a straight line can be.
+* spatial holds a k-d tree of every POI with finite coordinates
+* (spatialCount of them) for nearest and radius queries (spatial.h).
+* ch is the optional contraction hierarchy (see cityAddHierarchy()).
+*
+* Every array lives in one contiguous image laid out exactly like the
+* binary snapshot file, so a city is either built in memory from a
+* graph_t or mapped straight from a snapshot with mmap, with no parsing
+* and no per-element allocation.
+**/
+typedef struct {
+    csr_graph_t net;
+    const city_poi_t* pois;
+    const uint32_t* roadNames;
+    const char* strings;
+    uint32_t stringsSize;
+    const city_name_slot_t* nameIndex;
+    uint32_t nameSlots;
+    const uint32_t* sortedNames;
+    uint32_t sortedNameCount;
+    const city_spatial_point_t* spatial;
+    uint32_t spatialCount;
+    double heuristicScale;
+    city_hierarchy_t ch;
+    void* image;
+    size_t imageSize;
+    int mapped;
+} city_t;
+
+/**
+* Reads a tab-separated POI/road data file into a new graph.
+* Node data is a POIData and edge data a RoadData, both allocated
+* with graphAlloc() so freeGraph() releases them. POI and road names
+* are interned into names, and the data records hold their handles.
+* @return Pointer to the graph, or NULL if the file is malformed
+* or memory allocation fails.
+**/
+graph_t* buildGraphFromFile(FILE* fp, strpool_t* names);
+
+/**
+* Packs a graph built by buildGraphFromFile() into a city.
+* The pool becomes the city's string table, so every distinct name is
+* stored once. The city does not reference the graph or pool afterwards.
+* @return Pointer to the city, or NULL on failure.
+**/
+city_t* cityFromGraph(graph_t* graph, const strpool_t* names);
+
+/**
+* Loads a city from either a snapshot (detected by its header) or a
+* tab-separated data file. Snapshots are mapped read-only with mmap.
+* @return Pointer to the city, or NULL on failure.
+**/
+city_t* loadCity(const char* filename);
+
+/**
+* Finds the first node whose POI name is exactly name.
+* @return The node index, or -1 if no POI has that name.
+**/
+int cityFindNode(const city_t* city, const char* name);
+
+/**
+* Finds up to k distinct POI names matching a partial or misspelled
+* query, ignoring ASCII case. Names starting with the query rank
+* first (alphabetically); then names whose best prefix is within
+* CITY_SEARCH_MAX_EDITS edits of the query (1 for queries of up to
+* 4 characters), by edit count and then alphabetically. Only the first
+* CITY_SEARCH_MAX_QUERY characters of the query are used.
+* @param out Receives the matching names as string table offsets.
+* @return Number of matches written to out.
+**/
+int citySearchNames(const city_t* city, const char* query, int k, uint32_t* out);
+
+/**
+* Builds a contraction hierarchy for the city (buildHierarchy()) and
+* adds it to the city's image, so writeCitySnapshot() stores it and
+* a mapped snapshot has it without preprocessing. Does nothing if the
+* city already has one.
+* @return 1 on success, 0 on failure (the city is left unchanged).
+**/
+int cityAddHierarchy(city_t* city);
+
+/**
+* Writes the city as a versioned binary snapshot.
+* @return 1 on success, 0 on failure.
+**/
+int writeCitySnapshot(const city_t* city, const char* filename);
+
+/**
+* Frees (or unmaps) a city.
+* If the city pointer is NULL, the function does nothing.
+**/
+void freeCity(city_t* city);
+
+#endif
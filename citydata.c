@@ -3,266 +3,638 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
 #include "graph.h"
-#include "testgraph.h"
-
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
+#include "city.h"
+#include "geo.h"
+#include "route.h"
+#include "spatial.h"
+#include "flood.h"
+#include "depot.h"
 
 static void usage(const char *prog) {
     printf("Usage: %s -f <filename> [options]\n", prog);
     printf("Options (order may vary; multiple outputs follow order of args):\n");
-    printf("  -f <filename>                : (required) tab-separated data file\n");
+    printf("  -f <filename>                : (required) tab-separated data file or mksnapshot output\n");
     printf("  -location <locationname>     : print latitude longitude\n");
     printf("  -diameter                    : print lat1 lon1 lat2 lon2 distance_m\n");
+    printf("  -roaddiameter                : print lat1 lon1 lat2 lon2 road_distance_m of the longest route\n");
     printf("  -distance <name1> <name2>    : print great-circle distance (meters)\n");
     printf("  -roaddist <name1> <name2>    : print shortest road distance (meters)\n");
+    printf("  -roadstats <name1> <name2>   : print router, road distance and nodes settled\n");
+    printf("  -router <name>               : road query algorithm: dijkstra (default), astar, bidir or ch\n");
+    printf("  -heap <name>                 : road query priority queue: binary, quad (default) or radix\n");
+    printf("  -nearest <lat> <lon> <k>     : print the k POIs closest to a point, with distances (meters)\n");
+    printf("  -within <lat> <lon> <meters> : print every POI within a radius of a point, nearest first\n");
+    printf("  -isochrone <name> <meters>   : print every POI within meters of road distance from name, nearest first\n");
+    printf("  -search <text> <k>           : print up to k POI names matching a prefix or near-miss\n");
+    printf("  -matrix <origins> <targets> <out|->\n");
+    printf("                               : road distances between the names listed one per line in\n");
+    printf("                                 two files; - prints TSV, otherwise writes a binary matrix\n");
+    printf("  -flood <mm> <steps>          : rain mm per step for steps steps and print flooded nodes,\n");
+    printf("                                 impassable roads, max depth (mm) and the deepest POI\n");
+    printf("  -rain <mm> <steps>           : advance the ongoing storm by steps steps of mm rain and print\n");
+    printf("                                 step, flooded nodes and impassable roads; later -roaddist and\n");
+    printf("                                 -roadstats avoid the impassable roads\n");
+    printf("  -depots <file>               : shortest road distances from the POIs named one per line in the\n");
+    printf("                                 file, kept up to date by later -rain; prints depots and POIs reached\n");
+    printf("  -depotdist <name>            : print the road distance from the nearest depot and its name\n");
+    printf("  -ensemble <scenarios> <steps> <out|->\n");
+    printf("                               : run each storm in the file (lines of peak_mm duration_steps\n");
+    printf("                                 [lat lon radius_m]) for steps steps; per POI max depth,\n");
+    printf("                                 scenarios flooded and first flood step as TSV\n");
+    printf("  -threads <n>                 : worker threads for -matrix, -roaddiameter and -ensemble\n");
+    printf("                                 (default: one per CPU)\n");
+    printf("  -batch <queryfile|->         : answer tab-separated query lines, one answer per line\n");
     printf("\nNotes:\n  - Names containing spaces must be passed quoted so they appear as single argv entries.\n");
+    printf("  - Batch query lines are <op>\\t<arg>..., e.g. roaddist\\tLibrary\\tStadium; - reads stdin.\n");
+    printf("  - In a batch, matrix and ensemble must write to a file; - as the output prints ERROR.\n");
 }
 
-static double deg2rad(double d) {
-    return d * M_PI / 180.0;
-}
+typedef enum { OP_LOCATION, OP_DIAMETER, OP_ROADDIAMETER, OP_DISTANCE, OP_ROADDIST, OP_ROADSTATS, OP_ISOCHRONE, OP_SEARCH, OP_NEAREST, OP_WITHIN, OP_MATRIX, OP_FLOOD, OP_RAIN, OP_DEPOTS, OP_DEPOTDIST, OP_ENSEMBLE, OP_BATCH } OpType;
 
-static double haversine_m(double lat1, double lon1, double lat2, double lon2) {
-    double R = 6371000.0;
-    double phi1 = deg2rad(lat1);
-    double phi2 = deg2rad(lat2);
-    double dphi = deg2rad(lat2 - lat1);
-    double dlambda = deg2rad(lon2 - lon1);
-
-    double a = sin(dphi/2.0) * sin(dphi/2.0) +
-               cos(phi1) * cos(phi2) *
-               sin(dlambda/2.0) * sin(dlambda/2.0);
-    double c = 2.0 * atan2(sqrt(a), sqrt(1 - a));
-    return R * c;
-}
+#define SEARCH_MAX_RESULTS 100
 
-static node_t* find_node_by_name(graph_t *g, const char *name) {
-    if (!g) return NULL;
-    for (int i = 0; i < g->nodeCount; ++i) {
-        node_t *n = g->nodes[i];
-        if (n && n->data) {
-            POIData *p = (POIData*) n->data;
-            if (strcmp(p->name, name) == 0) return n;
-        }
-    }
-    return NULL;
-}
+typedef struct {
+    OpType type;
+    char *arg1;
+    char *arg2;
+    char *arg3;
+} Op;
 
-static graph_t* build_graph_from_file(FILE *fp) {
-    if (!fp) return NULL;
-    graph_t *g = createGraph();
-    if (!g) return NULL;
+// Algorithm for -roaddist and -roadstats, chosen with -router.
+static route_algo_t router = ROUTE_DIJKSTRA;
 
-    int numPOI = 0;
-    if (fscanf(fp, "%d", &numPOI) != 1 || numPOI <= 0) {
-        freeGraph(g);
-        return NULL;
-    }
+// Scratch memory shared by every -roaddist / -roadstats of the run, so
+// a batch query costs time in proportion to the area it searches.
+static search_workspace_t *workspace = NULL;
+
+// Priority queue for those searches, chosen with -heap.
+static heap_kind_t heapKind = HEAP_QUAD;
 
-    int ch = fgetc(fp);
-    if (ch != '\n' && ch != EOF) ungetc(ch, fp);
+// Worker threads for -matrix, -roaddiameter and -ensemble, chosen with -threads;
+// 0 means one per CPU.
+static int threads = 0;
 
-    for (int i = 0; i < numPOI; ++i) {
-        char line[1024];
-        if (!fgets(line, sizeof(line), fp)) { freeGraph(g); return NULL; }
+// Runoff shares for -flood and -ensemble, built on first use and kept
+// for the run.
+static flood_model_t *floodModel = NULL;
 
-        char name[256];
-        int id;
-        double lat, lon;
+// The storm advanced by -rain, and the closures it puts on the roads
+// for -roaddist / -roadstats; both NULL until the first -rain.
+static flood_state_t *storm = NULL;
+static route_overlay_t *closures = NULL;
 
-        char *p = line;
-        if (sscanf(p, "%d", &id) != 1) { freeGraph(g); return NULL; }
+// Distances from the depots of -depots, repaired as -rain closes and
+// reopens roads; NULL until the first -depots.
+static depot_tree_t *shelters = NULL;
 
-        char *tab1 = strchr(p, '\t');
-        if (!tab1) { freeGraph(g); return NULL; }
-        tab1++;
+static int worker_count(void) {
+    return threads > 0 ? threads : (int) sysconf(_SC_NPROCESSORS_ONLN);
+}
 
-        char *tab2 = strchr(tab1, '\t');
-        if (!tab2) { freeGraph(g); return NULL; }
+/*
+ * Parses the point and count / radius of -nearest and -within. The
+ * coordinates must be in range and the third value positive (k) or
+ * non-negative (radius). Returns 1 if all three are valid.
+ */
+static int parse_point_query(const Op *op, double *lat, double *lon, double *value) {
+    char *end;
+    *lat = strtod(op->arg1, &end);
+    if (end == op->arg1 || *end != '\0' || !(*lat >= -90.0 && *lat <= 90.0)) return 0;
+    *lon = strtod(op->arg2, &end);
+    if (end == op->arg2 || *end != '\0' || !(*lon >= -180.0 && *lon <= 180.0)) return 0;
+    *value = strtod(op->arg3, &end);
+    if (end == op->arg3 || *end != '\0' || !(*value >= 0.0) || isinf(*value)) return 0;
+    return op->type != OP_NEAREST || *value >= 1.0;
+}
 
-        size_t namelen = tab2 - tab1;
-        if (namelen >= sizeof(name)) namelen = sizeof(name)-1;
-        memcpy(name, tab1, namelen);
-        name[namelen] = '\0';
+// Prints spatial query results as name<TAB>distance pairs on one line.
+static void print_hits(const city_t *c, const int *nodes, const double *dists, int count) {
+    if (count == 0) printf("NOTFOUND");
+    for (int i = 0; i < count; ++i)
+        printf("%s%s\t%.3f", i ? "\t" : "", c->strings + c->pois[nodes[i]].name, dists[i]);
+    printf("\n");
+}
+
+/*
+ * Reads one POI name per line from filename and resolves each to a
+ * node index (-1 if unknown). Blank lines are skipped. names and
+ * nodes are allocated together and released with free_name_list().
+ * Returns the number of names, or -1 on error.
+ */
+static int read_name_list(const city_t *c, const char *filename, char ***names, int **nodes) {
+    FILE *in = fopen(filename, "r");
+    if (!in) { perror("fopen"); return -1; }
+
+    char *line = NULL;
+    size_t cap = 0;
+    int count = 0, space = 0, ok = 1;
+    *names = NULL;
+    *nodes = NULL;
+    while (ok && getline(&line, &cap, in) != -1) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') continue;
+        if (count == space) {
+            space = space ? space * 2 : 64;
+            char **grownNames = realloc(*names, sizeof(char*) * space);
+            if (grownNames) *names = grownNames;
+            int *grownNodes = realloc(*nodes, sizeof(int) * space);
+            if (grownNodes) *nodes = grownNodes;
+            if (!grownNames || !grownNodes) { ok = 0; break; }
+        }
+        (*names)[count] = strdup(line);
+        if (!(*names)[count]) { ok = 0; break; }
+        (*nodes)[count] = cityFindNode(c, line);
+        count++;
+    }
+
+    free(line);
+    fclose(in);
+    if (!ok) {
+        for (int i = 0; i < count; ++i) free((*names)[i]);
+        free(*names);
+        free(*nodes);
+        fprintf(stderr, "Error: out of memory reading '%s'\n", filename);
+        return -1;
+    }
+    return count;
+}
 
-        if (sscanf(tab2+1, "%lf\t%lf", &lat, &lon) != 2) { freeGraph(g); return NULL; }
+static void free_name_list(char **names, int *nodes, int count) {
+    for (int i = 0; i < count; ++i) free(names[i]);
+    free(names);
+    free(nodes);
+}
 
-        POIData *poi = malloc(sizeof(POIData));
-        if (!poi) { freeGraph(g); return NULL; }
-        strncpy(poi->name, name, sizeof(poi->name)-1);
-        poi->name[sizeof(poi->name)-1] = '\0';
-        poi->lat = lat;
-        poi->lon = lon;
+/*
+ * -matrix: TSV on stdout (a header row of target names, then one row
+ * per origin), or a binary file of int32 rows, int32 cols and
+ * rows x cols row-major doubles in host byte order, with INFINITY for
+ * unknown names and unreachable pairs. The binary form prints
+ * "rows cols" so a batch still gets one answer line per query.
+ */
+static void run_matrix(const city_t *c, const Op *op) {
+    char **srcNames = NULL, **dstNames = NULL;
+    int *srcNodes = NULL, *dstNodes = NULL;
+    int rows = read_name_list(c, op->arg1, &srcNames, &srcNodes);
+    int cols = rows < 0 ? -1 : read_name_list(c, op->arg2, &dstNames, &dstNodes);
+    double *out = NULL;
+    if (rows < 0 || cols < 0) goto fail;
+
+    out = malloc(sizeof(double) * ((size_t) rows * cols + 1));
+    if (!out || !routeMatrix(c, srcNodes, rows, dstNodes, cols, heapKind, worker_count(), out)) {
+        fprintf(stderr, "Error: out of memory computing matrix\n");
+        goto fail;
+    }
 
-        if (!addNode(g, id, poi)) {
-            free(poi);
-            freeGraph(g);
-            return NULL;
+    if (strcmp(op->arg3, "-") == 0) {
+        for (int j = 0; j < cols; ++j) printf("\t%s", dstNames[j]);
+        printf("\n");
+        for (int i = 0; i < rows; ++i) {
+            printf("%s", srcNames[i]);
+            for (int j = 0; j < cols; ++j) {
+                double d = out[(size_t) i * cols + j];
+                if (srcNodes[i] < 0 || dstNodes[j] < 0) printf("\tNOTFOUND");
+                else if (!isfinite(d)) printf("\tUNREACHABLE");
+                else printf("\t%.3f", d);
+            }
+            printf("\n");
         }
+    } else {
+        FILE *fp = fopen(op->arg3, "wb");
+        int32_t dims[2] = {rows, cols};
+        int ok = fp && fwrite(dims, sizeof(dims), 1, fp) == 1 &&
+                 fwrite(out, sizeof(double), (size_t) rows * cols, fp) == (size_t) rows * cols;
+        if (fp && fclose(fp) != 0) ok = 0;
+        if (!ok) { perror(op->arg3); goto fail; }
+        printf("%d %d\n", rows, cols);
     }
+    free(out);
+    free_name_list(srcNames, srcNodes, rows);
+    free_name_list(dstNames, dstNodes, cols);
+    return;
+
+fail:
+    printf("ERROR\n");
+    free(out);
+    if (rows >= 0) free_name_list(srcNames, srcNodes, rows);
+    if (cols >= 0) free_name_list(dstNames, dstNodes, cols);
+}
 
-    int numRoads = 0;
-    if (fscanf(fp, "%d", &numRoads) != 1 || numRoads <= 0) {
-        freeGraph(g);
-        return NULL;
+/*
+ * Parses the result count of -search and the step count of -flood,
+ * -rain and -ensemble: a whole positive number with nothing after it.
+ * Returns it, or -1 if invalid.
+ */
+static int parse_count(const char *text) {
+    char *end;
+    errno = 0;
+    long count = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno || count <= 0 || count > INT_MAX) return -1;
+    return (int) count;
+}
+
+/*
+ * -flood: a storm of constant intensity over the whole city with the
+ * default model parameters. Prints "flooded impassable max_mm name",
+ * the counts at the end of the storm and the deepest water any POI
+ * held (with its name), or ERROR for bad arguments.
+ */
+static void run_flood(const city_t *c, const Op *op) {
+    char *end;
+    double rain = strtod(op->arg1, &end);
+    int steps = parse_count(op->arg2);
+    if (end == op->arg1 || *end != '\0' || !(rain >= 0.0) || isinf(rain) || steps <= 0) {
+        printf("ERROR\n");
+        return;
+    }
+    if (!floodModel) floodModel = createFloodModel(c, NULL);
+    flood_state_t *state = floodModel ? createFloodState(floodModel) : NULL;
+    if (!state) { printf("ERROR\n"); return; }
+
+    for (int i = 0; i < steps; ++i) floodStep(floodModel, state, rain, NULL);
+    int deepest = 0;
+    for (int v = 1; v < state->nodeCount; ++v) {
+        if (state->maxDepth[v] > state->maxDepth[deepest]) deepest = v;
     }
+    printf("%d %d %.3f %s\n", state->floodedNodes, state->impassableEdges,
+           state->nodeCount ? state->maxDepth[deepest] : 0.0,
+           state->nodeCount ? c->strings + c->pois[deepest].name : "-");
+    freeFloodState(state);
+}
 
-    ch = fgetc(fp);
-    if (ch != '\n' && ch != EOF) ungetc(ch, fp);
-
-    for (int i = 0; i < numRoads; ++i) {
-        char line[1024];
-        if (!fgets(line, sizeof(line), fp)) { freeGraph(g); return NULL; }
-
-        int fromId, toId;
-        char dist_token[64];
-        double lat, lon;
-        char roadName[256];
-
-        char *p = line;
-        char *tab1 = strchr(p, '\t');
-        if (!tab1) { freeGraph(g); return NULL; }
-        *tab1 = '\0';
-        fromId = atoi(p);
-        p = tab1 + 1;
-
-        char *tab2 = strchr(p, '\t');
-        if (!tab2) { freeGraph(g); return NULL; }
-        *tab2 = '\0';
-        toId = atoi(p);
-        p = tab2 + 1;
-
-        char *tab3 = strchr(p, '\t');
-        if (!tab3) { freeGraph(g); return NULL; }
-        *tab3 = '\0';
-        strncpy(dist_token, p, sizeof(dist_token)-1);
-        dist_token[sizeof(dist_token)-1] = '\0';
-        p = tab3 + 1;
-
-        char *tab4 = strchr(p, '\t');
-        if (!tab4) { freeGraph(g); return NULL; }
-        *tab4 = '\0';
-        if (sscanf(p, "%lf", &lat) != 1) { freeGraph(g); return NULL; }
-        p = tab4 + 1;
-
-        char *tab5 = strchr(p, '\t');
-        if (!tab5) { freeGraph(g); return NULL; }
-        *tab5 = '\0';
-        if (sscanf(p, "%lf", &lon) != 1) { freeGraph(g); return NULL; }
-        p = tab5 + 1;
-
-        char *newline = strchr(p, '\n');
-        if (newline) *newline = '\0';
-        strncpy(roadName, p, sizeof(roadName)-1);
-        roadName[sizeof(roadName)-1] = '\0';
-
-        float distVal = 0.0f;
-        if (strcmp(dist_token, "NaN") != 0) {
-            double tmp;
-            if (sscanf(dist_token, "%lf", &tmp) == 1) distVal = (float)tmp;
-            else { freeGraph(g); return NULL; }
-        } else {
-            distVal = 0.0f;
+/*
+ * -rain: advances the run's storm and keeps the road closures (and the
+ * depot distances of -depots) in step with it, one update per tick at
+ * the cost of the roads that changed. Prints "step flooded impassable".
+ */
+static void run_rain(const city_t *c, const Op *op) {
+    char *end;
+    double rain = strtod(op->arg1, &end);
+    int steps = parse_count(op->arg2);
+    if (end == op->arg1 || *end != '\0' || !(rain >= 0.0) || isinf(rain) || steps <= 0) {
+        printf("ERROR\n");
+        return;
+    }
+    if (!floodModel) floodModel = createFloodModel(c, NULL);
+    if (floodModel && !storm) storm = createFloodState(floodModel);
+    if (floodModel && !closures) closures = createRouteOverlay(c);
+    if (!storm || !closures) { printf("ERROR\n"); return; }
+
+    for (int i = 0; i < steps; ++i) {
+        floodStep(floodModel, storm, rain, NULL);
+        floodUpdateOverlay(storm, closures);
+        if (shelters && !depotTreeSyncOverlay(shelters, closures, storm->toggled, storm->toggledCount)) {
+            freeDepotTree(shelters);
+            shelters = NULL;
+            fprintf(stderr, "Error: out of memory updating depots\n");
         }
+    }
+    printf("%d %d %d\n", storm->step, storm->floodedNodes, storm->impassableEdges);
+}
 
-        RoadData *rd = malloc(sizeof(RoadData));
-        if (!rd) { freeGraph(g); return NULL; }
-        strncpy(rd->roadName, roadName, sizeof(rd->roadName)-1);
-        rd->roadName[sizeof(rd->roadName)-1] = '\0';
+/*
+ * -depots: replaces the run's depot tree with one over the named POIs
+ * and the current closures. Unknown names are skipped. Prints
+ * "depots reached", the depots found and the POIs some depot reaches.
+ */
+static void run_depots(const city_t *c, const Op *op) {
+    char **names;
+    int *nodes;
+    int count = read_name_list(c, op->arg1, &names, &nodes);
+    if (count < 0) { printf("ERROR\n"); return; }
+    freeDepotTree(shelters);
+    shelters = createDepotTree(c, closures, nodes, count);
+    if (!shelters) {
+        printf("ERROR\n");
+    } else {
+        int found = 0, reached = 0;
+        for (int i = 0; i < count; ++i) found += nodes[i] >= 0;
+        for (int v = 0; v < c->net.nodeCount; ++v) reached += shelters->depot[v] >= 0;
+        printf("%d %d\n", found, reached);
+    }
+    free_name_list(names, nodes, count);
+}
 
-        if (!addEdge(g, fromId, toId, distVal, rd)) {
-            free(rd);
-            freeGraph(g);
-            return NULL;
+/*
+ * Reads the storms of -ensemble, one per line: peak and duration, then
+ * optionally the centre and radius of a storm cell. Blank lines and
+ * lines starting with '#' are skipped. Returns the number of storms
+ * (*out to be freed by the caller), or -1 on error.
+ */
+static int read_scenarios(const char *filename, flood_scenario_t **out) {
+    FILE *in = fopen(filename, "r");
+    if (!in) { perror("fopen"); return -1; }
+
+    char *line = NULL;
+    size_t cap = 0;
+    int count = 0, space = 0, ok = 1;
+    *out = NULL;
+    while (ok && getline(&line, &cap, in) != -1) {
+        line[strcspn(line, "\r\n#")] = '\0';
+        if (line[strspn(line, " \t")] == '\0') continue;
+        if (count == space) {
+            space = space ? space * 2 : 64;
+            flood_scenario_t *grown = realloc(*out, sizeof(flood_scenario_t) * space);
+            if (!grown) { ok = 0; break; }
+            *out = grown;
         }
+        flood_scenario_t sc = {0.0, 0, 0.0, 0.0, 0.0};
+        char extra;
+        int fields = sscanf(line, "%lf %d %lf %lf %lf %c", &sc.peak, &sc.duration, &sc.lat, &sc.lon, &sc.radius, &extra);
+        ok = (fields == 2 || fields == 5) && sc.peak >= 0.0 && !isinf(sc.peak) && sc.duration > 0 &&
+             (fields == 2 || (sc.lat >= -90.0 && sc.lat <= 90.0 && sc.lon >= -180.0 && sc.lon <= 180.0 && sc.radius > 0.0));
+        if (!ok) fprintf(stderr, "Error: bad storm '%s' in '%s'\n", line, filename);
+        (*out)[count++] = sc;
     }
 
-    return g;
+    free(line);
+    fclose(in);
+    if (!ok) {
+        free(*out);
+        *out = NULL;
+        return -1;
+    }
+    return count;
 }
 
-typedef struct {
-    int idx;
-    double dist;
-} HeapItem;
+/*
+ * -ensemble: every storm in the file, spread over the worker threads.
+ * Prints name, max depth (mm), scenarios flooded and first flood step
+ * (-1 for never) for each POI, to stdout for "-" or to the output
+ * file, in which case the answer line is "scenarios flooded_pois".
+ */
+static void run_ensemble(const city_t *c, const Op *op) {
+    flood_scenario_t *storms = NULL;
+    int count = read_scenarios(op->arg1, &storms);
+    int steps = parse_count(op->arg2), n = c->net.nodeCount;
+    double *maxDepth = malloc(sizeof(double) * (n + 1));
+    int *floodCount = malloc(sizeof(int) * (n + 1)), *firstFlood = malloc(sizeof(int) * (n + 1));
+    FILE *fp = NULL;
+
+    if (count < 0 || steps <= 0 || !maxDepth || !floodCount || !firstFlood) goto fail;
+    if (!floodModel) floodModel = createFloodModel(c, NULL);
+    if (!floodModel || !floodEnsemble(floodModel, storms, count, steps, worker_count(), maxDepth, floodCount, firstFlood)) {
+        fprintf(stderr, "Error: out of memory running ensemble\n");
+        goto fail;
+    }
 
-static void swap_heap(HeapItem *a, HeapItem *b) {
-    HeapItem tmp = *a; *a = *b; *b = tmp;
+    int toStdout = strcmp(op->arg3, "-") == 0, flooded = 0;
+    fp = toStdout ? stdout : fopen(op->arg3, "w");
+    if (!fp) { perror(op->arg3); goto fail; }
+    for (int v = 0; v < n; ++v) {
+        fprintf(fp, "%s\t%.3f\t%d\t%d\n", c->strings + c->pois[v].name, maxDepth[v], floodCount[v], firstFlood[v]);
+        flooded += floodCount[v] > 0;
+    }
+    if (!toStdout) {
+        int ok = !ferror(fp);
+        if (fclose(fp) != 0 || !ok) { perror(op->arg3); goto fail; }
+        printf("%d %d\n", count, flooded);
+    }
+    free(storms);
+    free(maxDepth);
+    free(floodCount);
+    free(firstFlood);
+    return;
+
+fail:
+    printf("ERROR\n");
+    free(storms);
+    free(maxDepth);
+    free(floodCount);
+    free(firstFlood);
 }
 
-static void heap_push(HeapItem heap[], int *heap_size, HeapItem item) {
-    int i = (*heap_size)++;
-    heap[i] = item;
-    while (i > 0) {
-        int parent = (i - 1) / 2;
-        if (heap[parent].dist <= heap[i].dist) break;
-        swap_heap(&heap[parent], &heap[i]);
-        i = parent;
+static void run_op(const city_t *c, const Op *op) {
+    if (op->type == OP_LOCATION) {
+        int n = cityFindNode(c, op->arg1);
+        if (n < 0) {
+            printf("NOTFOUND\n");
+        } else {
+            const city_poi_t *p = &c->pois[n];
+            printf("%.7f %.7f\n", p->lat, p->lon);
+        }
+    } else if (op->type == OP_DIAMETER) {
+        int a, b;
+        double best = geoDiameter(c->pois, c->net.nodeCount, &a, &b);
+        if (best < 0.0) {
+            printf("0\n");
+        } else {
+            const city_poi_t *pa = &c->pois[a], *pb = &c->pois[b];
+            printf("%.7f %.7f %.7f %.7f %.2f\n", pa->lat, pa->lon, pb->lat, pb->lon, best);
+        }
+    } else if (op->type == OP_ROADDIAMETER) {
+        int a, b;
+        double best = routeDiameter(c, heapKind, worker_count(), NULL, &a, &b);
+        if (isnan(best)) {
+            printf("ERROR\n");
+        } else if (best < 0.0) {
+            printf("0\n");
+        } else {
+            const city_poi_t *pa = &c->pois[a], *pb = &c->pois[b];
+            printf("%.7f %.7f %.7f %.7f %.2f\n", pa->lat, pa->lon, pb->lat, pb->lon, best);
+        }
+    } else if (op->type == OP_DISTANCE) {
+        int n1 = cityFindNode(c, op->arg1);
+        int n2 = cityFindNode(c, op->arg2);
+        if (n1 < 0 || n2 < 0) {
+            printf("NOTFOUND\n");
+        } else {
+            const city_poi_t *p1 = &c->pois[n1];
+            const city_poi_t *p2 = &c->pois[n2];
+            double d = haversine(p1->lat, p1->lon, p2->lat, p2->lon);
+            printf("%.3f\n", d);
+        }
+    } else if (op->type == OP_ROADDIST || op->type == OP_ROADSTATS) {
+        int sIndex = cityFindNode(c, op->arg1);
+        int tIndex = cityFindNode(c, op->arg2);
+        if (sIndex < 0 || tIndex < 0) {
+            printf("NOTFOUND\n");
+        } else {
+            int settled;
+            double dist = routeQueryOverlay(workspace, c, router, closures, sIndex, tIndex, &settled);
+            if (op->type == OP_ROADSTATS) printf("%s ", routeAlgoName(router));
+            if (!isfinite(dist)) printf("UNREACHABLE");
+            else printf("%.3f", dist);
+            if (op->type == OP_ROADSTATS) printf(" %d", settled);
+            printf("\n");
+        }
+    } else if (op->type == OP_ISOCHRONE) {
+        int sIndex = cityFindNode(c, op->arg1);
+        char *end;
+        double limit = strtod(op->arg2, &end);
+        if (end == op->arg2 || *end != '\0' || !(limit >= 0.0)) {
+            printf("ERROR\n");
+        } else if (sIndex < 0) {
+            printf("NOTFOUND\n");
+        } else {
+            int *nodes;
+            double *dists;
+            int count = routeIsochrone(workspace, c, closures, sIndex, limit, &nodes, &dists);
+            if (count < 0) printf("ERROR\n");
+            else print_hits(c, nodes, dists, count);
+            free(nodes);
+            free(dists);
+        }
+    } else if (op->type == OP_SEARCH) {
+        uint32_t found[SEARCH_MAX_RESULTS];
+        int k = parse_count(op->arg2);
+        if (k > SEARCH_MAX_RESULTS) k = SEARCH_MAX_RESULTS;
+        int count = citySearchNames(c, op->arg1, k, found);
+        if (count == 0) printf("NOTFOUND\n");
+        for (int i = 0; i < count; ++i)
+            printf("%s%c", c->strings + found[i], i + 1 < count ? '\t' : '\n');
+    } else if (op->type == OP_NEAREST || op->type == OP_WITHIN) {
+        double lat, lon, value;
+        if (!parse_point_query(op, &lat, &lon, &value)) {
+            printf("ERROR\n");
+        } else if (op->type == OP_NEAREST) {
+            int k = value < c->spatialCount ? (int) value : (int) c->spatialCount;
+            int *nodes = malloc(sizeof(int) * (k + 1));
+            double *dists = malloc(sizeof(double) * (k + 1));
+            if (!nodes || !dists) printf("ERROR\n");
+            else print_hits(c, nodes, dists, spatialNearest(c, lat, lon, k, nodes, dists));
+            free(nodes);
+            free(dists);
+        } else {
+            int *nodes;
+            double *dists;
+            int count = spatialWithin(c, lat, lon, value, &nodes, &dists);
+            if (count < 0) printf("ERROR\n");
+            else print_hits(c, nodes, dists, count);
+            free(nodes);
+            free(dists);
+        }
+    } else if (op->type == OP_MATRIX) {
+        run_matrix(c, op);
+    } else if (op->type == OP_FLOOD) {
+        run_flood(c, op);
+    } else if (op->type == OP_RAIN) {
+        run_rain(c, op);
+    } else if (op->type == OP_DEPOTS) {
+        run_depots(c, op);
+    } else if (op->type == OP_DEPOTDIST) {
+        int v = cityFindNode(c, op->arg1);
+        if (!shelters) {
+            printf("ERROR\n");
+        } else if (v < 0) {
+            printf("NOTFOUND\n");
+        } else if (shelters->depot[v] < 0) {
+            printf("UNREACHABLE\n");
+        } else {
+            int d = shelters->depots[shelters->depot[v]];
+            printf("%.3f %s\n", shelters->dist[v], c->strings + c->pois[d].name);
+        }
+    } else if (op->type == OP_ENSEMBLE) {
+        run_ensemble(c, op);
     }
 }
 
-static HeapItem heap_pop(HeapItem heap[], int *heap_size) {
-    HeapItem result = heap[0];
-    (*heap_size)--;
-    heap[0] = heap[*heap_size];
-    int i = 0;
-    while (1) {
-        int l = 2*i + 1, r = 2*i + 2, smallest = i;
-        if (l < *heap_size && heap[l].dist < heap[smallest].dist) smallest = l;
-        if (r < *heap_size && heap[r].dist < heap[smallest].dist) smallest = r;
-        if (smallest == i) break;
-        swap_heap(&heap[i], &heap[smallest]);
-        i = smallest;
+/*
+ * Parses one batch query line into op. Fields are tab-separated so that
+ * names may contain spaces; the operation word may be given with or
+ * without the leading '-'. Output "-" is refused for matrix and
+ * ensemble, whose tables would take several lines of the
+ * one-answer-per-line stream. The line buffer is modified in place.
+ * Returns 1 on success, 0 for a blank line, -1 for a malformed query.
+ */
+static int parse_query_line(char *line, Op *op) {
+    char *fields[5];
+    int nfields = 0;
+
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[0] == '\0') return 0;
+
+    char *p = line;
+    while (nfields < 5) {
+        fields[nfields++] = p;
+        char *tab = strchr(p, '\t');
+        if (!tab) break;
+        *tab = '\0';
+        p = tab + 1;
     }
-    return result;
+
+    const char *word = fields[0];
+    if (word[0] == '-') word++;
+
+    if (strcmp(word, "location") == 0 && nfields == 2) {
+        *op = (Op){OP_LOCATION, fields[1], NULL};
+    } else if (strcmp(word, "diameter") == 0 && nfields == 1) {
+        *op = (Op){OP_DIAMETER, NULL, NULL};
+    } else if (strcmp(word, "roaddiameter") == 0 && nfields == 1) {
+        *op = (Op){OP_ROADDIAMETER, NULL, NULL};
+    } else if (strcmp(word, "distance") == 0 && nfields == 3) {
+        *op = (Op){OP_DISTANCE, fields[1], fields[2]};
+    } else if (strcmp(word, "roaddist") == 0 && nfields == 3) {
+        *op = (Op){OP_ROADDIST, fields[1], fields[2]};
+    } else if (strcmp(word, "roadstats") == 0 && nfields == 3) {
+        *op = (Op){OP_ROADSTATS, fields[1], fields[2]};
+    } else if (strcmp(word, "isochrone") == 0 && nfields == 3) {
+        *op = (Op){OP_ISOCHRONE, fields[1], fields[2]};
+    } else if (strcmp(word, "search") == 0 && nfields == 3 && parse_count(fields[2]) > 0) {
+        *op = (Op){OP_SEARCH, fields[1], fields[2]};
+    } else if (strcmp(word, "nearest") == 0 && nfields == 4) {
+        *op = (Op){OP_NEAREST, fields[1], fields[2], fields[3]};
+    } else if (strcmp(word, "within") == 0 && nfields == 4) {
+        *op = (Op){OP_WITHIN, fields[1], fields[2], fields[3]};
+    } else if (strcmp(word, "matrix") == 0 && nfields == 4 && strcmp(fields[3], "-") != 0) {
+        *op = (Op){OP_MATRIX, fields[1], fields[2], fields[3]};
+    } else if (strcmp(word, "flood") == 0 && nfields == 3) {
+        *op = (Op){OP_FLOOD, fields[1], fields[2]};
+    } else if (strcmp(word, "rain") == 0 && nfields == 3) {
+        *op = (Op){OP_RAIN, fields[1], fields[2]};
+    } else if (strcmp(word, "depots") == 0 && nfields == 2) {
+        *op = (Op){OP_DEPOTS, fields[1], NULL};
+    } else if (strcmp(word, "depotdist") == 0 && nfields == 2) {
+        *op = (Op){OP_DEPOTDIST, fields[1], NULL};
+    } else if (strcmp(word, "ensemble") == 0 && nfields == 4 && strcmp(fields[3], "-") != 0) {
+        *op = (Op){OP_ENSEMBLE, fields[1], fields[2], fields[3]};
+    } else {
+        return -1;
+    }
+    return 1;
 }
 
-static double dijkstra_on_graph(graph_t *g, int sIndex, int tIndex) {
-    if (!g) return INFINITY;
-    int n = g->nodeCount;
-    double *dist = malloc(sizeof(double) * n);
-    int *visited = malloc(sizeof(int) * n);
-    if (!dist || !visited) { free(dist); free(visited); return INFINITY; }
-    for (int i = 0; i < n; ++i) { dist[i] = INFINITY; visited[i] = 0; }
-    dist[sIndex] = 0.0;
-
-    HeapItem *heap = malloc(sizeof(HeapItem) * n * 2);
-    int heap_size = 0;
-    heap_push(heap, &heap_size, (HeapItem){sIndex, 0.0});
-
-    while (heap_size > 0) {
-        HeapItem it = heap_pop(heap, &heap_size);
-        int u = it.idx;
-        if (visited[u]) continue;
-        visited[u] = 1;
-        if (u == tIndex) break;
-
-        node_t *node = g->nodes[u];
-        edge_t *e = node->edges;
-        while (e) {
-            int vIndex = -1;
-            for (int k = 0; k < g->nodeCount; ++k) {
-                if (g->nodes[k] == e->toNode) { vIndex = k; break; }
-            }
-            if (vIndex >= 0 && !visited[vIndex]) {
-                double alt = dist[u] + (double) e->weight;
-                if (alt < dist[vIndex]) {
-                    dist[vIndex] = alt;
-                    heap_push(heap, &heap_size, (HeapItem){vIndex, alt});
-                }
-            }
-            e = e->next;
-        }
+/*
+ * Answers queries from a file (or stdin for "-") against the already
+ * loaded graph, one output line per query line. Malformed lines produce
+ * "ERROR" so answers stay aligned with their queries.
+ */
+static int run_batch(const city_t *c, const char *source) {
+    int interactive = strcmp(source, "-") == 0;
+    FILE *in = interactive ? stdin : fopen(source, "r");
+    if (!in) { perror("fopen"); return 0; }
+
+    char *line = NULL;
+    size_t cap = 0;
+    while (getline(&line, &cap, in) != -1) {
+        Op op;
+        int rc = parse_query_line(line, &op);
+        if (rc == 0) continue;
+        if (rc < 0) printf("ERROR\n");
+        else run_op(c, &op);
+        if (interactive) fflush(stdout);
     }
 
-    double result = dist[tIndex];
+    free(line);
+    if (!interactive) fclose(in);
+    return 1;
+}
 
-    free(dist);
-    free(visited);
-    free(heap);
-    return result;
+static int push_op(Op **ops, int *opcount, int *opspace, Op op) {
+    if (*opcount == *opspace) {
+        int space = *opspace ? *opspace * 2 : 16;
+        Op *grown = realloc(*ops, sizeof(Op) * space);
+        if (!grown) return 0;
+        *ops = grown;
+        *opspace = space;
+    }
+    (*ops)[(*opcount)++] = op;
+    return 1;
 }
 
 int main(int argc, char **argv) {
@@ -270,111 +642,143 @@ int main(int argc, char **argv) {
 
     char *filename = NULL;
 
-    typedef enum { OP_LOCATION, OP_DIAMETER, OP_DISTANCE, OP_ROADDIST } OpType;
-    typedef struct {
-        OpType type;
-        char *arg1;
-        char *arg2;
-    } Op;
-
-    Op ops[64];
-    int opcount = 0;
+    Op *ops = NULL;
+    int opcount = 0, opspace = 0;
+    int ok = 1;
 
-    for (int i = 1; i < argc; ++i) {
+    for (int i = 1; i < argc && ok; ++i) {
         if (strcmp(argv[i], "-f") == 0) {
-            if (i + 1 >= argc) { fprintf(stderr, "Error: -f requires filename\n"); return 1; }
+            if (i + 1 >= argc) { fprintf(stderr, "Error: -f requires filename\n"); free(ops); return 1; }
             filename = argv[++i];
         } else if (strcmp(argv[i], "-location") == 0) {
-            if (i + 1 >= argc) { fprintf(stderr, "Error: -location requires name\n"); return 1; }
-            ops[opcount++] = (Op){OP_LOCATION, argv[++i], NULL};
+            if (i + 1 >= argc) { fprintf(stderr, "Error: -location requires name\n"); free(ops); return 1; }
+            ok = push_op(&ops, &opcount, &opspace, (Op){OP_LOCATION, argv[i+1], NULL});
+            i += 1;
         } else if (strcmp(argv[i], "-diameter") == 0) {
-            ops[opcount++] = (Op){OP_DIAMETER, NULL, NULL};
+            ok = push_op(&ops, &opcount, &opspace, (Op){OP_DIAMETER, NULL, NULL});
+        } else if (strcmp(argv[i], "-roaddiameter") == 0) {
+            ok = push_op(&ops, &opcount, &opspace, (Op){OP_ROADDIAMETER, NULL, NULL});
         } else if (strcmp(argv[i], "-distance") == 0) {
-            if (i + 2 >= argc) { fprintf(stderr, "Error: -distance requires two names\n"); return 1; }
-            ops[opcount++] = (Op){OP_DISTANCE, argv[++i], argv[++i]};
+            if (i + 2 >= argc) { fprintf(stderr, "Error: -distance requires two names\n"); free(ops); return 1; }
+            ok = push_op(&ops, &opcount, &opspace, (Op){OP_DISTANCE, argv[i+1], argv[i+2]});
+            i += 2;
         } else if (strcmp(argv[i], "-roaddist") == 0) {
-            if (i + 2 >= argc) { fprintf(stderr, "Error: -roaddist requires two names\n"); return 1; }
-            ops[opcount++] = (Op){OP_ROADDIST, argv[++i], argv[++i]};
+            if (i + 2 >= argc) { fprintf(stderr, "Error: -roaddist requires two names\n"); free(ops); return 1; }
+            ok = push_op(&ops, &opcount, &opspace, (Op){OP_ROADDIST, argv[i+1], argv[i+2]});
+            i += 2;
+        } else if (strcmp(argv[i], "-roadstats") == 0) {
+            if (i + 2 >= argc) { fprintf(stderr, "Error: -roadstats requires two names\n"); free(ops); return 1; }
+            ok = push_op(&ops, &opcount, &opspace, (Op){OP_ROADSTATS, argv[i+1], argv[i+2]});
+            i += 2;
+        } else if (strcmp(argv[i], "-isochrone") == 0) {
+            if (i + 2 >= argc) { fprintf(stderr, "Error: -isochrone requires a name and a distance in meters\n"); free(ops); return 1; }
+            ok = push_op(&ops, &opcount, &opspace, (Op){OP_ISOCHRONE, argv[i+1], argv[i+2]});
+            i += 2;
+        } else if (strcmp(argv[i], "-router") == 0) {
+            if (i + 1 >= argc || routeAlgoFromName(argv[i+1]) < 0) { fprintf(stderr, "Error: -router requires dijkstra, astar, bidir or ch\n"); free(ops); return 1; }
+            router = (route_algo_t) routeAlgoFromName(argv[++i]);
+        } else if (strcmp(argv[i], "-heap") == 0) {
+            if (i + 1 >= argc || heapKindFromName(argv[i+1]) < 0) { fprintf(stderr, "Error: -heap requires binary, quad or radix\n"); free(ops); return 1; }
+            heapKind = (heap_kind_t) heapKindFromName(argv[++i]);
+        } else if (strcmp(argv[i], "-search") == 0) {
+            if (i + 2 >= argc || parse_count(argv[i+2]) <= 0) { fprintf(stderr, "Error: -search requires text and a positive count\n"); free(ops); return 1; }
+            ok = push_op(&ops, &opcount, &opspace, (Op){OP_SEARCH, argv[i+1], argv[i+2]});
+            i += 2;
+        } else if (strcmp(argv[i], "-nearest") == 0 || strcmp(argv[i], "-within") == 0) {
+            Op op = {strcmp(argv[i], "-nearest") == 0 ? OP_NEAREST : OP_WITHIN, NULL, NULL, NULL};
+            double lat, lon, value;
+            if (i + 3 < argc) op = (Op){op.type, argv[i+1], argv[i+2], argv[i+3]};
+            if (!op.arg1 || !parse_point_query(&op, &lat, &lon, &value)) {
+                fprintf(stderr, "Error: %s requires a latitude, a longitude and a %s\n", argv[i],
+                        op.type == OP_NEAREST ? "positive count" : "radius in meters");
+                free(ops);
+                return 1;
+            }
+            ok = push_op(&ops, &opcount, &opspace, op);
+            i += 3;
+        } else if (strcmp(argv[i], "-matrix") == 0) {
+            if (i + 3 >= argc) { fprintf(stderr, "Error: -matrix requires origin and target files and an output (or -)\n"); free(ops); return 1; }
+            ok = push_op(&ops, &opcount, &opspace, (Op){OP_MATRIX, argv[i+1], argv[i+2], argv[i+3]});
+            i += 3;
+        } else if (strcmp(argv[i], "-flood") == 0) {
+            if (i + 2 >= argc || parse_count(argv[i+2]) <= 0) { fprintf(stderr, "Error: -flood requires mm per step and a positive step count\n"); free(ops); return 1; }
+            ok = push_op(&ops, &opcount, &opspace, (Op){OP_FLOOD, argv[i+1], argv[i+2]});
+            i += 2;
+        } else if (strcmp(argv[i], "-rain") == 0) {
+            if (i + 2 >= argc || parse_count(argv[i+2]) <= 0) { fprintf(stderr, "Error: -rain requires mm per step and a positive step count\n"); free(ops); return 1; }
+            ok = push_op(&ops, &opcount, &opspace, (Op){OP_RAIN, argv[i+1], argv[i+2]});
+            i += 2;
+        } else if (strcmp(argv[i], "-depots") == 0) {
+            if (i + 1 >= argc) { fprintf(stderr, "Error: -depots requires a file of names\n"); free(ops); return 1; }
+            ok = push_op(&ops, &opcount, &opspace, (Op){OP_DEPOTS, argv[i+1], NULL});
+            i += 1;
+        } else if (strcmp(argv[i], "-depotdist") == 0) {
+            if (i + 1 >= argc) { fprintf(stderr, "Error: -depotdist requires a name\n"); free(ops); return 1; }
+            ok = push_op(&ops, &opcount, &opspace, (Op){OP_DEPOTDIST, argv[i+1], NULL});
+            i += 1;
+        } else if (strcmp(argv[i], "-ensemble") == 0) {
+            if (i + 3 >= argc || parse_count(argv[i+2]) <= 0) { fprintf(stderr, "Error: -ensemble requires a storm file, a positive step count and an output (or -)\n"); free(ops); return 1; }
+            ok = push_op(&ops, &opcount, &opspace, (Op){OP_ENSEMBLE, argv[i+1], argv[i+2], argv[i+3]});
+            i += 3;
+        } else if (strcmp(argv[i], "-threads") == 0) {
+            if (i + 1 >= argc || atoi(argv[i+1]) <= 0) { fprintf(stderr, "Error: -threads requires a positive count\n"); free(ops); return 1; }
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-batch") == 0) {
+            if (i + 1 >= argc) { fprintf(stderr, "Error: -batch requires a query file or -\n"); free(ops); return 1; }
+            ok = push_op(&ops, &opcount, &opspace, (Op){OP_BATCH, argv[i+1], NULL});
+            i += 1;
         } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
             usage(argv[0]);
+            free(ops);
             return 0;
         } else {
             fprintf(stderr, "Warning: unknown argument '%s' ignored\n", argv[i]);
         }
     }
+    if (!ok) { fprintf(stderr, "Error: out of memory\n"); free(ops); return 1; }
 
-    if (!filename) { fprintf(stderr, "Error: -f <filename> is required\n"); usage(argv[0]); return 1; }
+    if (!filename) { fprintf(stderr, "Error: -f <filename> is required\n"); usage(argv[0]); free(ops); return 1; }
 
-    FILE *fp = fopen(filename, "r");
-    if (!fp) { perror("fopen"); return 1; }
+    city_t *c = loadCity(filename);
+    if (!c) { fprintf(stderr, "Error: failed to load graph from '%s'\n", filename); free(ops); return 1; }
 
-    graph_t *g = build_graph_from_file(fp);
-    fclose(fp);
-    if (!g) { fprintf(stderr, "Error: failed to load graph from '%s'\n", filename); return 1; }
+    if (opcount == 0) { usage(argv[0]); freeCity(c); free(ops); return 0; }
 
-    if (opcount == 0) { usage(argv[0]); freeGraph(g); return 0; }
+    // Snapshots written with mksnapshot -ch carry a hierarchy; otherwise
+    // build one now, which only pays off for many queries per load.
+    if (router == ROUTE_CH && !cityAddHierarchy(c)) {
+        fprintf(stderr, "Error: could not build contraction hierarchy\n");
+        freeCity(c);
+        free(ops);
+        return 1;
+    }
 
+    workspace = createWorkspace();
+    if (!workspace) {
+        fprintf(stderr, "Error: out of memory\n");
+        freeCity(c);
+        free(ops);
+        return 1;
+    }
+    workspace->heapKind = heapKind;
+
+    int status = 0;
     for (int oi = 0; oi < opcount; ++oi) {
-        Op op = ops[oi];
-        if (op.type == OP_LOCATION) {
-            node_t *n = find_node_by_name(g, op.arg1);
-            if (!n || !n->data) {
-                printf("NOTFOUND\n");
-            } else {
-                POIData *p = (POIData*) n->data;
-                printf("%.7f %.7f\n", p->lat, p->lon);
-            }
-        } else if (op.type == OP_DIAMETER) {
-            double best = -1.0;
-            POIData *pa = NULL, *pb = NULL;
-            int ai=-1, bi=-1;
-            for (int i = 0; i < g->nodeCount; ++i) {
-                POIData *pi = (POIData*) g->nodes[i]->data;
-                for (int j = i+1; j < g->nodeCount; ++j) {
-                    POIData *pj = (POIData*) g->nodes[j]->data;
-                    double d = haversine_m(pi->lat, pi->lon, pj->lat, pj->lon);
-                    if (d > best) { best = d; pa = pi; pb = pj; ai=i; bi=j; }
-                }
-            }
-            if (best < 0.0) {
-                printf("0\n");
-            } else {
-                printf("%.7f %.7f %.7f %.7f %.2f\n", pa->lat, pa->lon, pb->lat, pb->lon, best);
-            }
-        } else if (op.type == OP_DISTANCE) {
-            node_t *n1 = find_node_by_name(g, op.arg1);
-            node_t *n2 = find_node_by_name(g, op.arg2);
-            if (!n1 || !n2) {
-                printf("NOTFOUND\n");
-            } else {
-                POIData *p1 = (POIData*) n1->data;
-                POIData *p2 = (POIData*) n2->data;
-                double d = haversine_m(p1->lat, p1->lon, p2->lat, p2->lon);
-                printf("%.3f\n", d);
-            }
-        } else if (op.type == OP_ROADDIST) {
-            node_t *n1 = find_node_by_name(g, op.arg1);
-            node_t *n2 = find_node_by_name(g, op.arg2);
-            if (!n1 || !n2) {
-                printf("NOTFOUND\n");
-            } else {
-                int sIndex=-1, tIndex=-1;
-                for (int i = 0; i < g->nodeCount; ++i) {
-                    if (g->nodes[i] == n1) sIndex = i;
-                    if (g->nodes[i] == n2) tIndex = i;
-                }
-                if (sIndex < 0 || tIndex < 0) { printf("NOTFOUND\n"); }
-                else {
-                    double dist = dijkstra_on_graph(g, sIndex, tIndex);
-                    if (!isfinite(dist)) printf("UNREACHABLE\n");
-                    else printf("%.3f\n", dist);
-                }
-            }
+        if (ops[oi].type == OP_BATCH) {
+            if (!run_batch(c, ops[oi].arg1)) status = 1;
+        } else {
+            run_op(c, &ops[oi]);
         }
     }
 
-    freeGraph(g);
-    return 0;
+    freeWorkspace(workspace);
+    freeDepotTree(shelters);
+    freeRouteOverlay(closures);
+    freeFloodState(storm);
+    freeFloodModel(floodModel);
+    free(ops);
+    freeCity(c);
+    return status;
 }
 
 
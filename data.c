@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
 #include "data.h"
 
 int is_valid_id(const char *s) {
@@ -83,6 +84,328 @@ int validate() {
     return 0;
 }
 
+/*
+ * validateStream(): the same checks as validate(), on a hand-written
+ * tokenizer. Each scan_* function below stands for one scanf
+ * conversion and follows glibc's rules for it, including where it
+ * stops reading, so both report the same line for any input.
+ */
+
+#define STREAM_CHUNK (1 << 20)
+#define EXACT_MANTISSA_MAX 9007199254740992ULL
+
+typedef struct {
+    FILE *fp;
+    char *buf;
+    size_t pos;
+    size_t len;
+    int eof;
+    char *tok;
+    size_t tokLen;
+    size_t tokCap;
+    int exact;
+    int oom;
+} stream_t;
+
+static const double pow10_table[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Called by STREAM_GETC() when the buffer is used up.
+static int stream_fill(stream_t *s) {
+    if (s->eof || !s->fp) return EOF;
+    s->len = fread(s->buf, 1, STREAM_CHUNK, s->fp);
+    s->pos = 0;
+    if (s->len == 0) {
+        s->eof = 1;
+        return EOF;
+    }
+    return (unsigned char) s->buf[s->pos++];
+}
+
+/*
+ * The per-character steps are macros: the Makefile builds without
+ * optimisation, so a call per character would cost more than the
+ * scanf this replaces. STREAM_UNGETC() only ever undoes the last
+ * STREAM_GETC(), which is in the buffer. IS_SPACE() is isspace() in
+ * the C locale, which is the one validate() runs in.
+ */
+#define STREAM_GETC(s) ((s)->pos < (s)->len ? (unsigned char) (s)->buf[(s)->pos++] : stream_fill(s))
+#define STREAM_UNGETC(s, c) do { if ((c) != EOF) (s)->pos--; } while (0)
+#define TOK_ADD(s, c) ((s)->tokLen < (s)->tokCap ? ((s)->tok[(s)->tokLen++] = (char) (c), 1) : tok_grow(s, c))
+#define IS_SPACE(c) ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+#define IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
+
+static int skip_space(stream_t *s) {
+    int c;
+    while ((c = STREAM_GETC(s)) != EOF && IS_SPACE(c)) {}
+    return c;
+}
+
+static int tok_grow(stream_t *s, int c) {
+    size_t cap = s->tokCap ? 2 * s->tokCap : 64;
+    char *tok = realloc(s->tok, cap);
+    if (!tok) { s->oom = 1; return 0; }
+    s->tok = tok;
+    s->tokCap = cap;
+    s->tok[s->tokLen++] = (char) c;
+    return 1;
+}
+
+// %<max>s
+static int scan_word(stream_t *s, char *out, int max) {
+    int c = skip_space(s);
+    if (c == EOF) return 0;
+    int n = 0;
+    for (;;) {
+        if (IS_SPACE(c)) { STREAM_UNGETC(s, c); break; }
+        out[n++] = (char) c;
+        if (n == max || (c = STREAM_GETC(s)) == EOF) break;
+    }
+    out[n] = '\0';
+    return 1;
+}
+
+// %<max>[^\t\n], or %<max>[^\n] when tabs are allowed; no space skipping.
+static int scan_until(stream_t *s, char *out, int max, int allowTabs) {
+    int n = 0, c;
+    while (n < max && (c = STREAM_GETC(s)) != EOF) {
+        if (c == '\n' || (c == '\t' && !allowTabs)) { STREAM_UNGETC(s, c); break; }
+        out[n++] = (char) c;
+    }
+    out[n] = '\0';
+    return n > 0;
+}
+
+// %d: strtol() saturates on overflow and scanf narrows the long to int.
+static int scan_int(stream_t *s, int *out) {
+    int c = skip_space(s);
+    if (c == EOF) return 0;
+    int neg = 0, digits = 0;
+    long v = 0;
+    if (c == '-' || c == '+') {
+        neg = c == '-';
+        c = STREAM_GETC(s);
+    }
+    for (; c != EOF && IS_DIGIT(c); c = STREAM_GETC(s), digits++) {
+        int d = c - '0';
+        if (neg) v = v < (LONG_MIN + d) / 10 ? LONG_MIN : v * 10 - d;
+        else v = v > (LONG_MAX - d) / 10 ? LONG_MAX : v * 10 + d;
+    }
+    STREAM_UNGETC(s, c);
+    if (digits == 0) return 0;
+    *out = (int) v;
+    return 1;
+}
+
+static int expect_char(stream_t *s, char lower) {
+    int c = STREAM_GETC(s);
+    if (c == EOF || tolower(c) != lower) return 0;
+    return TOK_ADD(s, c);
+}
+
+// The token as strtod() reads it; it accepts a non-empty prefix.
+static int convert_token(stream_t *s, double *out) {
+    if (!TOK_ADD(s, '\0')) return 0;
+    char *end;
+    *out = strtod(s->tok, &end);
+    s->exact = 1;
+    return end != s->tok;
+}
+
+/*
+ * Fast path of scan_double() for a plain decimal that ends inside the
+ * buffer (or the string, for parses_as_double()), converted from the
+ * digits as they are read: exactly (s->exact) when the significant
+ * digits fit a double and one division by a power of ten rounds them,
+ * otherwise to within a few ulps from the first 19 significant digits,
+ * which is all a range check away from its limits needs (see
+ * out_of_range()). Returns 0 without consuming anything when the
+ * number needs the general path.
+ */
+static int scan_decimal(stream_t *s, double *out) {
+    const char *start = s->buf + s->pos, *p = start, *end = s->buf + s->len;
+    int neg = 0, dot = 0, digits = 0, used = 0, scale = 0;
+    unsigned long long m = 0;
+    if (*p == '-' || *p == '+') neg = *p++ == '-';
+    for (; p < end; ++p) {
+        if (*p == '.' && !dot) { dot = 1; continue; }
+        if (!IS_DIGIT(*p)) break;
+        digits++;
+        if (m == 0 && *p == '0') {
+            if (dot) scale++;
+        } else if (used < 19) {
+            m = m * 10 + (*p - '0');
+            used++;
+            if (dot) scale++;
+        } else if (!dot) {
+            scale--;
+        }
+    }
+    if ((p == end && s->fp) || digits == 0 || scale > 22 || scale < -22) return 0;
+    if (p < end && (*p == 'e' || *p == 'E' || *p == 'x' || *p == 'X')) return 0;
+
+    double v = scale >= 0 ? (double) m / pow10_table[scale] : (double) m * pow10_table[-scale];
+    s->exact = scale >= 0 && m <= EXACT_MANTISSA_MAX;
+    if (!s->exact) {
+        s->tokLen = 0;
+        for (const char *q = start; q < p; ++q) {
+            if (!TOK_ADD(s, *q)) return 0;
+        }
+        if (!TOK_ADD(s, '\0')) return 0;
+    }
+    s->pos = p - s->buf;
+    *out = neg ? -v : v;
+    return 1;
+}
+
+// %lf: takes the characters glibc's scanf would, then converts them.
+static int scan_double(stream_t *s, double *out) {
+    int c = skip_space(s);
+    if (c == EOF) return 0;
+    STREAM_UNGETC(s, c);
+    if (scan_decimal(s, out)) return 1;
+    if (s->oom) return 0;
+
+    c = STREAM_GETC(s);
+    int gotSign = 0, gotDigit = 0, gotDot = 0, gotE = 0, hex = 0;
+    char expChar = 'e';
+    s->tokLen = 0;
+    if (c == '-' || c == '+') {
+        gotSign = 1;
+        if (!TOK_ADD(s, c) || (c = STREAM_GETC(s)) == EOF) return 0;
+    }
+    if (c == 'n' || c == 'N') {
+        if (!TOK_ADD(s, c) || !expect_char(s, 'a') || !expect_char(s, 'n')) return 0;
+        return convert_token(s, out);
+    }
+    if (c == 'i' || c == 'I') {
+        if (!TOK_ADD(s, c) || !expect_char(s, 'n') || !expect_char(s, 'f')) return 0;
+        c = STREAM_GETC(s);
+        if (c == 'i' || c == 'I') {
+            if (!TOK_ADD(s, c) || !expect_char(s, 'n') || !expect_char(s, 'i') ||
+                !expect_char(s, 't') || !expect_char(s, 'y')) return 0;
+        } else {
+            STREAM_UNGETC(s, c);
+        }
+        return convert_token(s, out);
+    }
+    if (c == '0') {
+        if (!TOK_ADD(s, c)) return 0;
+        c = STREAM_GETC(s);
+        if (c == 'x' || c == 'X') {
+            if (!TOK_ADD(s, c)) return 0;
+            hex = 1;
+            expChar = 'p';
+            c = STREAM_GETC(s);
+        } else {
+            gotDigit = 1;
+        }
+    }
+    while (c != EOF) {
+        if (IS_DIGIT(c) || (hex && !gotE && isxdigit(c))) {
+            gotDigit = 1;
+        } else if (gotE && s->tok[s->tokLen - 1] == expChar && (c == '-' || c == '+')) {
+            // sign of the exponent
+        } else if (gotDigit && !gotE && tolower(c) == expChar) {
+            c = expChar;
+            gotE = gotDot = 1;
+        } else if (!gotDot && c == '.') {
+            gotDot = 1;
+        } else {
+            STREAM_UNGETC(s, c);
+            break;
+        }
+        if (!TOK_ADD(s, c)) return 0;
+        c = STREAM_GETC(s);
+    }
+    if (s->tokLen == (size_t) gotSign || (hex && s->tokLen == 2 + (size_t) gotSign)) return 0;
+    return convert_token(s, out);
+}
+
+// The coordinate check of validate() for the number just scanned.
+static int out_of_range(stream_t *s, double v, double limit) {
+    double gap = v < 0 ? -v - limit : v - limit;
+    if (!s->exact && gap < 1e-9 && gap > -1e-9) v = strtod(s->tok, NULL);
+    return v < -limit || v > limit;
+}
+
+static int name_is_blank(const char *name) {
+    while (IS_SPACE(*name)) name++;
+    return *name == '\0';
+}
+
+// sscanf(text, "%lf", ...) == 1
+static int parses_as_double(stream_t *s, const char *text) {
+    stream_t str = *s;
+    double v;
+    str.fp = NULL;
+    str.buf = (char *) text;
+    str.pos = 0;
+    str.len = strlen(text);
+    int ok = scan_double(&str, &v);
+    s->tok = str.tok;
+    s->tokCap = str.tokCap;
+    s->oom = str.oom;
+    return ok;
+}
+
+static int validate_stream(stream_t *s) {
+    int line_number = 1;
+    int numPOI, numRoads;
+
+    if (!scan_int(s, &numPOI) || numPOI <= 0) return line_number;
+    line_number++;
+
+    for (int i = 0; i < numPOI; i++, line_number++) {
+        char id_str[32];
+        char name[128];
+        double lat, lon;
+
+        if (!scan_word(s, id_str, 31)) return line_number;
+        if (!scan_until(s, name, 127, 0)) return line_number;
+        if (!is_valid_id(id_str) || name_is_blank(name)) return line_number;
+        if (!scan_double(s, &lat) || out_of_range(s, lat, 90.0)) return line_number;
+        if (!scan_double(s, &lon) || out_of_range(s, lon, 180.0)) return line_number;
+    }
+
+    if (!scan_int(s, &numRoads) || numRoads <= 0) return line_number;
+    line_number++;
+
+    for (int i = 0; i < numRoads; i++, line_number++) {
+        char from_id[32], to_id[32];
+        char dist_str[32];
+        double lat, lon;
+        char road_name[128];
+
+        if (!scan_word(s, from_id, 31) || !scan_word(s, to_id, 31) || !scan_word(s, dist_str, 31))
+            return line_number;
+        if (!is_valid_id(from_id) || !is_valid_id(to_id)) return line_number;
+        if (strcmp(dist_str, "NaN") != 0 && !parses_as_double(s, dist_str)) return line_number;
+        if (!scan_double(s, &lat) || out_of_range(s, lat, 90.0)) return line_number;
+        if (!scan_double(s, &lon) || out_of_range(s, lon, 180.0)) return line_number;
+
+        int c = skip_space(s);
+        STREAM_UNGETC(s, c);
+        if (c == EOF || !scan_until(s, road_name, 127, 1)) return line_number;
+        if (strlen(road_name) == 0) return line_number;
+    }
+
+    return 0;
+}
+
+int validateStream(FILE* fp) {
+    stream_t s = {0};
+    s.fp = fp;
+    s.buf = malloc(STREAM_CHUNK);
+    if (!s.buf) return -1;
+    int result = validate_stream(&s);
+    free(s.buf);
+    free(s.tok);
+    return s.oom ? -1 : result;
+}
+
 
 
 
@@ -1,8 +1,26 @@
 #ifndef DATA_H
 #define DATA_H
 
+#include <stdio.h>
+
+/**
+* Validates the POI/road data file on stdin, reading it with scanf.
+* @return 0 if the file is valid, otherwise the number of the first
+* invalid line.
+**/
 int validate(void);
 
+/**
+* Same result as validate() for the same input, read from fp in large
+* chunks with a hand-written tokenizer instead of scanf. The tokenizer
+* follows scanf's rules for each conversion validate() uses (field
+* widths, whitespace skipping, what a number may look like), so line
+* numbers match even for malformed files.
+* @return 0 if the file is valid, the first invalid line number, or -1
+* if memory allocation fails.
+**/
+int validateStream(FILE* fp);
+
 #endif
 
 
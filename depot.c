@@ -0,0 +1,222 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "depot.h"
+
+// Weight of edge k of the city with the overlay's factor applied.
+static double edge_weight(const csr_graph_t *g, const route_overlay_t *overlay, int k) {
+    double w = overlay ? (double) g->weights[k] * overlay->factor[k] : (double) g->weights[k];
+    return isnan(w) ? INFINITY : w;
+}
+
+// The node edge k leaves, by binary search over the CSR offsets.
+static int edge_tail(const csr_graph_t *g, int k) {
+    int lo = 0, hi = g->nodeCount - 1;
+    while (lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+        if (g->offsets[mid] <= k) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+/*
+ * Dijkstra from whatever is queued in the workspace, over the current
+ * weights. Every queued node already holds its tentative dist, parent
+ * and depot; a node whose distance drops takes its new parent's depot,
+ * so re-rooted subtrees follow their new root. Returns 0 if the heap
+ * could not grow.
+ */
+static int settle(depot_tree_t *t) {
+    const csr_graph_t *g = &t->city->net;
+    search_workspace_t *ws = t->ws;
+    unsigned int *done = ws->settled[0], epoch = ws->epoch;
+    int count = 0, ok = 1;
+
+    while (ok && workspaceQueued(ws, 0) > 0) {
+        heap_item_t item = workspacePop(ws, 0);
+        int x = item.idx;
+        if (done[x] == epoch || item.dist > t->dist[x]) continue;
+        done[x] = epoch;
+        count++;
+        for (int k = g->offsets[x]; k < g->offsets[x + 1] && ok; ++k) {
+            int y = g->targets[k];
+            double alt = t->dist[x] + t->weight[k];
+            if (alt < t->dist[y]) {
+                t->dist[y] = alt;
+                t->parent[y] = k;
+                t->depot[y] = t->depot[x];
+                ok = workspacePush(ws, 0, y, alt, alt);
+            }
+        }
+    }
+    t->settled = count;
+    return ok;
+}
+
+/*
+ * Appends the forest subtree rooted at v to t->subtree (which holds
+ * count nodes) and returns the new count. A node's children are the
+ * heads of its out-edges whose parent is that edge; nodes already
+ * listed are skipped along with their subtrees, which are listed too.
+ */
+static int add_subtree(depot_tree_t *t, int v, int count) {
+    const csr_graph_t *g = &t->city->net;
+    int first = count;
+    t->inSubtree[v] = 1;
+    t->subtree[count++] = v;
+    for (int i = first; i < count; ++i) {
+        int x = t->subtree[i];
+        for (int k = g->offsets[x]; k < g->offsets[x + 1]; ++k) {
+            int y = g->targets[k];
+            if (t->parent[y] == k && !t->inSubtree[y]) {
+                t->inSubtree[y] = 1;
+                t->subtree[count++] = y;
+            }
+        }
+    }
+    return count;
+}
+
+depot_tree_t* createDepotTree(const city_t* city, const route_overlay_t* overlay, const int* depots, int depotCount) {
+    const csr_graph_t *g = &city->net;
+    int n = g->nodeCount, m = g->edgeCount;
+    if (depotCount < 0) depotCount = 0;
+    depot_tree_t *t = calloc(1, sizeof(depot_tree_t));
+    if (!t) return NULL;
+    t->city = city;
+    t->depotCount = depotCount;
+    t->depots = malloc(sizeof(int) * (depotCount + 1));
+    t->weight = malloc(sizeof(double) * (m + 1));
+    t->dist = malloc(sizeof(double) * (n + 1));
+    t->parent = malloc(sizeof(int) * (n + 1));
+    t->depot = malloc(sizeof(int) * (n + 1));
+    t->reverseEdge = malloc(sizeof(int) * (m + 1));
+    t->inSubtree = calloc(n + 1, 1);
+    t->subtree = malloc(sizeof(int) * (n + 1));
+    t->ws = createWorkspace();
+    int *cursor = malloc(sizeof(int) * (n + 1));
+    if (!t->depots || !t->weight || !t->dist || !t->parent || !t->depot || !t->reverseEdge || !t->inSubtree ||
+        !t->subtree || !t->ws || !cursor || !workspaceReset(t->ws, n)) {
+        free(cursor);
+        freeDepotTree(t);
+        return NULL;
+    }
+    if (depotCount > 0) memcpy(t->depots, depots, sizeof(int) * depotCount);
+    for (int k = 0; k < m; ++k) t->weight[k] = edge_weight(g, overlay, k);
+
+    // Same mapping as route_overlay_t's: reverse entry -> forward edge.
+    memcpy(cursor, g->revOffsets, sizeof(int) * n);
+    for (int u = 0; u < n; ++u) {
+        for (int k = g->offsets[u]; k < g->offsets[u + 1]; ++k) t->reverseEdge[cursor[g->targets[k]]++] = k;
+    }
+    free(cursor);
+
+    for (int v = 0; v < n; ++v) {
+        t->dist[v] = INFINITY;
+        t->parent[v] = -1;
+        t->depot[v] = -1;
+    }
+    int ok = 1;
+    for (int i = 0; i < depotCount && ok; ++i) {
+        int d = depots[i];
+        if (d < 0 || d >= n || t->depot[d] >= 0) continue;
+        t->dist[d] = 0.0;
+        t->depot[d] = i;
+        ok = workspacePush(t->ws, 0, d, 0.0, 0.0);
+    }
+    if (!ok || !settle(t)) {
+        freeDepotTree(t);
+        return NULL;
+    }
+    return t;
+}
+
+void freeDepotTree(depot_tree_t* tree) {
+    if (!tree) return;
+    free(tree->depots);
+    free(tree->weight);
+    free(tree->dist);
+    free(tree->parent);
+    free(tree->depot);
+    free(tree->reverseEdge);
+    free(tree->inSubtree);
+    free(tree->subtree);
+    freeWorkspace(tree->ws);
+    free(tree);
+}
+
+/*
+ * Ramalingam-Reps style repair for a batch of changes. Only a forest
+ * edge that gets longer can make distances grow, and only below it,
+ * so those subtrees (found on the old forest) are the affected nodes.
+ * They are reset and each is seeded from its in-neighbours outside
+ * them; the head of every shortened edge is seeded if the edge now
+ * gives it a shorter path. One Dijkstra from all seeds then settles
+ * the affected nodes and anything whose distance drops; nodes outside
+ * both keep their labels and are never touched.
+ */
+int depotTreeUpdate(depot_tree_t* tree, const int* edges, const double* weights, int count) {
+    const csr_graph_t *g = &tree->city->net;
+    for (int i = 0; i < count; ++i) {
+        if (edges[i] < 0 || edges[i] >= g->edgeCount || weights[i] < 0.0) return 0;
+    }
+    tree->affected = tree->settled = 0;
+    if (!workspaceReset(tree->ws, g->nodeCount)) return 0;
+
+    int affected = 0;
+    for (int i = 0; i < count; ++i) {
+        int k = edges[i], v = g->targets[k];
+        double w = isnan(weights[i]) ? INFINITY : weights[i];
+        if (w > tree->weight[k] && tree->parent[v] == k && !tree->inSubtree[v]) affected = add_subtree(tree, v, affected);
+    }
+    for (int i = 0; i < count; ++i) tree->weight[edges[i]] = isnan(weights[i]) ? INFINITY : weights[i];
+
+    for (int i = 0; i < affected; ++i) {
+        int x = tree->subtree[i];
+        tree->dist[x] = INFINITY;
+        tree->parent[x] = -1;
+        tree->depot[x] = -1;
+    }
+    int ok = 1;
+    for (int i = 0; i < affected && ok; ++i) {
+        int x = tree->subtree[i];
+        for (int r = g->revOffsets[x]; r < g->revOffsets[x + 1]; ++r) {
+            int u = g->revSources[r], k = tree->reverseEdge[r];
+            if (tree->inSubtree[u]) continue;
+            double alt = tree->dist[u] + tree->weight[k];
+            if (alt < tree->dist[x]) {
+                tree->dist[x] = alt;
+                tree->parent[x] = k;
+                tree->depot[x] = tree->depot[u];
+            }
+        }
+        if (tree->dist[x] < INFINITY) ok = workspacePush(tree->ws, 0, x, tree->dist[x], tree->dist[x]);
+    }
+    for (int i = 0; i < count && ok; ++i) {
+        int k = edges[i], u = edge_tail(g, k), v = g->targets[k];
+        if (tree->inSubtree[u]) continue;
+        double alt = tree->dist[u] + tree->weight[k];
+        if (alt < tree->dist[v]) {
+            tree->dist[v] = alt;
+            tree->parent[v] = k;
+            tree->depot[v] = tree->depot[u];
+            ok = workspacePush(tree->ws, 0, v, alt, alt);
+        }
+    }
+    for (int i = 0; i < affected; ++i) tree->inSubtree[tree->subtree[i]] = 0;
+    tree->affected = affected;
+    return ok && settle(tree);
+}
+
+int depotTreeSyncOverlay(depot_tree_t* tree, const route_overlay_t* overlay, const int* edges, int count) {
+    double *weights = malloc(sizeof(double) * (count + 1));
+    if (!weights) return 0;
+    for (int i = 0; i < count; ++i) {
+        int k = edges[i];
+        weights[i] = k >= 0 && k < tree->city->net.edgeCount ? edge_weight(&tree->city->net, overlay, k) : -1.0;
+    }
+    int ok = depotTreeUpdate(tree, edges, weights, count);
+    free(weights);
+    return ok;
+}
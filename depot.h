@@ -0,0 +1,77 @@
+#ifndef DEPOT_H
+#define DEPOT_H
+
+#include "city.h"
+#include "route.h"
+#include "workspace.h"
+
+/**
+* Shortest road distances from a set of depots to every node, kept up
+* to date as road weights change (dynamic single-source shortest
+* paths, the depots acting as one source).
+* weight[k] is the current weight of edge k of the city's network
+* (INFINITY while the road is removed); the city is not modified.
+* dist[v] is the distance from the nearest depot (INFINITY if none can
+* reach v), parent[v] the edge into v on its shortest path (-1 for
+* depots and unreached nodes) and depot[v] the index into depots of
+* the depot it is reached from (-1 if unreached). The parent edges form
+* a forest rooted at the depots.
+* After an update, affected is the number of nodes whose path used a
+* road that got longer or was removed and so had to be recomputed, and
+* settled the number of nodes the repair search settled.
+* A tree is not thread-safe.
+**/
+typedef struct {
+    const city_t* city;
+    int depotCount;
+    int* depots;
+    double* weight;
+    double* dist;
+    int* parent;
+    int* depot;
+    int* reverseEdge;
+    unsigned char* inSubtree;
+    int* subtree;
+    search_workspace_t* ws;
+    int affected;
+    int settled;
+} depot_tree_t;
+
+/**
+* Builds the shortest path forest from the depots (node indices;
+* negative entries are ignored) with one multi-source Dijkstra.
+* Edge k starts at the city's weight times overlay's factor for it
+* (overlay may be NULL); NaN weights count as removed roads.
+* @return Pointer to the tree, or NULL if memory allocation fails.
+**/
+depot_tree_t* createDepotTree(const city_t* city, const route_overlay_t* overlay, const int* depots, int depotCount);
+
+/**
+* Frees a tree. If the pointer is NULL, the function does nothing.
+**/
+void freeDepotTree(depot_tree_t* tree);
+
+/**
+* Changes the weights of count edges at once (weights[i] for
+* edges[i]) and repairs the distances. INFINITY removes a road and a
+* finite weight adds it back; NaN counts as INFINITY.
+* Lengthening or removing an edge off the forest changes nothing.
+* Lengthening a forest edge only recomputes the subtree below it:
+* those nodes are seeded from their neighbours outside it and a
+* Dijkstra restricted to what changes finishes the job. Shortening or
+* adding an edge starts that Dijkstra at its head. The cost therefore
+* follows the nodes whose distance or path changes, not the network.
+* @return 1 on success, 0 if a weight is negative or memory allocation
+* fails (the tree is then unchanged or, for memory, must be rebuilt).
+**/
+int depotTreeUpdate(depot_tree_t* tree, const int* edges, const double* weights, int count);
+
+/**
+* depotTreeUpdate() with each listed edge's weight taken from the
+* city and overlay, as in createDepotTree(). Passing the edges an
+* overlay changed (such as a flood state's toggled edges) keeps the
+* tree in step with it.
+**/
+int depotTreeSyncOverlay(depot_tree_t* tree, const route_overlay_t* overlay, const int* edges, int count);
+
+#endif
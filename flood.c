@@ -0,0 +1,282 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "flood.h"
+#include "geo.h"
+#include "workers.h"
+
+#define CACHE_LINE 64
+
+/*
+ * Run states and their arrays start on a cache line and fill whole
+ * lines, so the states and totals of different ensemble workers never
+ * share one.
+ */
+static void* line_alloc(size_t bytes) {
+    return aligned_alloc(CACHE_LINE, (bytes + CACHE_LINE) & ~(size_t) (CACHE_LINE - 1));
+}
+
+flood_model_t* createFloodModel(const city_t* city, const flood_params_t* params) {
+    flood_params_t p = FLOOD_DEFAULT_PARAMS;
+    if (params) p = *params;
+    if (!(p.runoff >= 0.0 && p.runoff <= 1.0) || !(p.drainage >= 0.0) ||
+        !(p.floodDepth > 0.0) || !(p.impassableDepth > 0.0)) return NULL;
+
+    const csr_graph_t *g = &city->net;
+    flood_model_t *model = calloc(1, sizeof(flood_model_t));
+    if (!model) return NULL;
+    model->city = city;
+    model->params = p;
+    model->outflow = malloc(sizeof(double) * (g->nodeCount + 1));
+    model->share = malloc(sizeof(double) * (g->edgeCount + 1));
+    if (!model->outflow || !model->share) {
+        freeFloodModel(model);
+        return NULL;
+    }
+
+    for (int u = 0; u < g->nodeCount; ++u) {
+        double total = 0.0;
+        for (int k = g->offsets[u]; k < g->offsets[u + 1]; ++k) {
+            double w = g->weights[k];
+            model->share[k] = isnan(w) ? 0.0 : 1.0 / (w > FLOOD_MIN_LENGTH ? w : FLOOD_MIN_LENGTH);
+            total += model->share[k];
+        }
+        for (int k = g->offsets[u]; k < g->offsets[u + 1]; ++k) {
+            model->share[k] /= total > 0.0 ? total : 1.0;
+        }
+        model->outflow[u] = total > 0.0 ? p.runoff : 0.0;
+    }
+    return model;
+}
+
+void freeFloodModel(flood_model_t* model) {
+    if (!model) return;
+    free(model->outflow);
+    free(model->share);
+    free(model);
+}
+
+flood_state_t* createFloodState(const flood_model_t* model) {
+    flood_state_t *state = line_alloc(sizeof(flood_state_t));
+    if (!state) return NULL;
+    memset(state, 0, sizeof(flood_state_t));
+    size_t n = model->city->net.nodeCount, m = model->city->net.edgeCount;
+    state->nodeCount = (int) n;
+    state->edgeCount = (int) m;
+    state->depth = line_alloc(sizeof(double) * n);
+    state->next = line_alloc(sizeof(double) * n);
+    state->maxDepth = line_alloc(sizeof(double) * n);
+    state->floodStep = line_alloc(sizeof(int) * n);
+    state->impassable = line_alloc(m);
+    state->toggled = line_alloc(sizeof(int) * m);
+    if (!state->depth || !state->next || !state->maxDepth || !state->floodStep || !state->impassable ||
+        !state->toggled) {
+        freeFloodState(state);
+        return NULL;
+    }
+    floodReset(state);
+    return state;
+}
+
+void floodReset(flood_state_t* state) {
+    size_t n = state->nodeCount;
+    memset(state->depth, 0, sizeof(double) * n);
+    memset(state->maxDepth, 0, sizeof(double) * n);
+    for (size_t v = 0; v < n; ++v) state->floodStep[v] = -1;
+    memset(state->impassable, 0, state->edgeCount);
+    state->step = 0;
+    state->toggledCount = 0;
+    state->floodedNodes = 0;
+    state->impassableEdges = 0;
+    state->rained = 0.0;
+    state->drained = 0.0;
+}
+
+void freeFloodState(flood_state_t* state) {
+    if (!state) return;
+    free(state->depth);
+    free(state->next);
+    free(state->maxDepth);
+    free(state->floodStep);
+    free(state->impassable);
+    free(state->toggled);
+    free(state);
+}
+
+/*
+ * Two passes over the CSR arrays. The first adds the rain, takes out
+ * the drainage and pushes each node's runoff to its road ends, writing
+ * only to next so the order of nodes does not matter; the buffers are
+ * then swapped. The second, with every depth final, updates the per-node
+ * statistics and re-marks each road from the depths at its ends.
+ */
+void floodStep(const flood_model_t* model, flood_state_t* state, double rainfall, const float* footprint) {
+    const csr_graph_t *g = &model->city->net;
+    const int *offsets = g->offsets, *targets = g->targets;
+    const double *outflow = model->outflow, *share = model->share;
+    double drainage = model->params.drainage, rained = 0.0, drained = 0.0;
+    double *depth = state->depth, *next = state->next;
+    int n = state->nodeCount;
+
+    memset(next, 0, sizeof(double) * n);
+    for (int u = 0; u < n; ++u) {
+        double rain = footprint ? rainfall * footprint[u] : rainfall;
+        double d = depth[u] + rain;
+        double taken = d < drainage ? d : drainage;
+        d -= taken;
+        rained += rain;
+        drained += taken;
+        double out = d * outflow[u];
+        next[u] += d - out;
+        if (out > 0.0) {
+            for (int k = offsets[u]; k < offsets[u + 1]; ++k) next[targets[k]] += out * share[k];
+        }
+    }
+    state->depth = next;
+    state->next = depth;
+    depth = next;
+    state->step++;
+    state->rained += rained;
+    state->drained += drained;
+
+    double floodDepth = model->params.floodDepth, roadDepth = 2.0 * model->params.impassableDepth;
+    double *maxDepth = state->maxDepth;
+    int *floodStep = state->floodStep, *toggled = state->toggled, flooded = 0, blocked = 0, changed = 0;
+    unsigned char *impassable = state->impassable;
+    for (int u = 0; u < n; ++u) {
+        double d = depth[u];
+        if (d > maxDepth[u]) maxDepth[u] = d;
+        if (d >= floodDepth) {
+            flooded++;
+            if (floodStep[u] < 0) floodStep[u] = state->step;
+        }
+        for (int k = offsets[u]; k < offsets[u + 1]; ++k) {
+            unsigned char now = d + depth[targets[k]] >= roadDepth;
+            if (now != impassable[k]) toggled[changed++] = k;
+            impassable[k] = now;
+            blocked += now;
+        }
+    }
+    state->toggledCount = changed;
+    state->floodedNodes = flooded;
+    state->impassableEdges = blocked;
+}
+
+void floodRun(const flood_model_t* model, flood_state_t* state, const double* rainfall, int steps,
+              const float* footprint) {
+    for (int i = 0; i < steps; ++i) floodStep(model, state, rainfall[i], footprint);
+}
+
+void floodUpdateOverlay(const flood_state_t* state, route_overlay_t* overlay) {
+    for (int i = 0; i < state->toggledCount; ++i) {
+        int k = state->toggled[i];
+        routeOverlaySet(overlay, k, state->impassable[k] ? INFINITY : 1.0f);
+    }
+}
+
+// Rain in step t of a scenario: a triangle over its duration.
+static double scenario_rain(const flood_scenario_t *sc, int t) {
+    if (t >= sc->duration) return 0.0;
+    double x = 2.0 * (t + 0.5) / sc->duration;
+    return sc->peak * (x < 1.0 ? x : 2.0 - x);
+}
+
+// Fills footprint for a storm cell; returns NULL for a city-wide storm.
+static const float* scenario_footprint(const city_t *city, const flood_scenario_t *sc, float *footprint) {
+    if (!(sc->radius > 0.0)) return NULL;
+    for (int v = 0; v < city->net.nodeCount; ++v) {
+        double d = haversine(city->pois[v].lat, city->pois[v].lon, sc->lat, sc->lon) / sc->radius;
+        footprint[v] = isfinite(d) ? (float) exp(-0.5 * d * d) : 0.0f;
+    }
+    return footprint;
+}
+
+typedef struct {
+    const flood_model_t *model;
+    const flood_scenario_t *scenarios;
+    int count;
+    int steps;
+    double *maxDepth;
+    int *floodCount;
+    int *firstFlood;
+    pthread_mutex_t merge;
+    atomic_int next;
+    atomic_int done;
+} ensemble_job_t;
+
+static void* ensemble_worker(void *arg) {
+    ensemble_job_t *job = arg;
+    int n = job->model->city->net.nodeCount;
+    flood_state_t *state = createFloodState(job->model);
+    float *footprint = line_alloc(sizeof(float) * n);
+    double *maxDepth = line_alloc(sizeof(double) * n);
+    int *floodCount = line_alloc(sizeof(int) * n);
+    int *firstFlood = line_alloc(sizeof(int) * n);
+    if (!state || !footprint || !maxDepth || !floodCount || !firstFlood) goto done;
+    for (int v = 0; v < n; ++v) {
+        maxDepth[v] = 0.0;
+        floodCount[v] = 0;
+        firstFlood[v] = -1;
+    }
+
+    int i, ran = 0;
+    while ((i = atomic_fetch_add(&job->next, 1)) < job->count) {
+        const flood_scenario_t *sc = &job->scenarios[i];
+        const float *cell = scenario_footprint(job->model->city, sc, footprint);
+        floodReset(state);
+        for (int t = 0; t < job->steps; ++t) floodStep(job->model, state, scenario_rain(sc, t), cell);
+        for (int v = 0; v < n; ++v) {
+            if (state->maxDepth[v] > maxDepth[v]) maxDepth[v] = state->maxDepth[v];
+            int at = state->floodStep[v];
+            if (at >= 0) {
+                floodCount[v]++;
+                if (firstFlood[v] < 0 || at < firstFlood[v]) firstFlood[v] = at;
+            }
+        }
+        ran++;
+    }
+
+    // Max, sum and min do not depend on the order of the merges.
+    pthread_mutex_lock(&job->merge);
+    for (int v = 0; v < n; ++v) {
+        if (job->maxDepth && maxDepth[v] > job->maxDepth[v]) job->maxDepth[v] = maxDepth[v];
+        if (job->floodCount) job->floodCount[v] += floodCount[v];
+        if (job->firstFlood && firstFlood[v] >= 0 && (job->firstFlood[v] < 0 || firstFlood[v] < job->firstFlood[v]))
+            job->firstFlood[v] = firstFlood[v];
+    }
+    pthread_mutex_unlock(&job->merge);
+    atomic_fetch_add(&job->done, ran);
+
+done:
+    freeFloodState(state);
+    free(footprint);
+    free(maxDepth);
+    free(floodCount);
+    free(firstFlood);
+    return NULL;
+}
+
+int floodEnsemble(const flood_model_t* model, const flood_scenario_t* scenarios, int count, int steps,
+                  int threads, double* maxDepth, int* floodCount, int* firstFlood) {
+    int n = model->city->net.nodeCount;
+    for (int v = 0; v < n; ++v) {
+        if (maxDepth) maxDepth[v] = 0.0;
+        if (floodCount) floodCount[v] = 0;
+        if (firstFlood) firstFlood[v] = -1;
+    }
+    if (count <= 0) return 1;
+
+    ensemble_job_t job = {model, scenarios, count, steps, maxDepth, floodCount, firstFlood};
+    if (pthread_mutex_init(&job.merge, NULL) != 0) return 0;
+    atomic_init(&job.next, 0);
+    atomic_init(&job.done, 0);
+
+    // A worker that could not start or allocate leaves its scenarios to
+    // the others.
+    runWorkers(ensemble_worker, &job, threads < count ? threads : count);
+
+    pthread_mutex_destroy(&job.merge);
+    return atomic_load(&job.done) == count;
+}
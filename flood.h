@@ -0,0 +1,160 @@
+#ifndef FLOOD_H
+#define FLOOD_H
+
+#include "city.h"
+#include "route.h"
+
+/**
+* Parameters of the rainfall model. Depths are in millimetres of water
+* standing at a node; one call to floodStep() is one timestep.
+* runoff is the fraction of a node's water that leaves it along its
+* outgoing roads per step (0 to 1); drainage is the depth storm drains
+* and soil remove from each node per step. A node is flooded while its
+* depth is at least floodDepth, and a road is impassable while the
+* mean depth of its two ends is at least impassableDepth.
+**/
+typedef struct {
+    double runoff;
+    double drainage;
+    double floodDepth;
+    double impassableDepth;
+} flood_params_t;
+
+#define FLOOD_DEFAULT_PARAMS {0.5, 0.2, 50.0, 150.0}
+#define FLOOD_MIN_LENGTH 1.0
+
+/**
+* The read-only part of a simulation over a city's road network:
+* the parameters and, per edge, the fraction of its tail's runoff it
+* carries (share, in the order of net's CSR edges). A node's runoff is
+* split over its outgoing roads in proportion to 1 / weight, so water
+* favours short roads (weights under FLOOD_MIN_LENGTH count as that
+* much); roads with a NaN weight carry none, and a node whose roads all
+* have NaN weights (or that has none) is a sink.
+* outflow[v] is params.runoff for nodes with somewhere to send water
+* and 0 for sinks. The model points into the city, which must outlive
+* it, and may be shared by any number of states and threads.
+**/
+typedef struct {
+    const city_t* city;
+    flood_params_t params;
+    double* outflow;
+    double* share;
+} flood_model_t;
+
+/**
+* The evolving state of one simulation, in contiguous per-node and
+* per-edge arrays indexed like the city's CSR graph.
+* depth is the water at each node after step steps; maxDepth the most
+* it has held and floodStep the step at which it first reached
+* floodDepth (-1 if it never has). impassable[k] is 1 while edge k is
+* impassable; the edges whose mark changed in the last step are
+* toggled[0] .. toggled[toggledCount-1]. floodedNodes and
+* impassableEdges count the nodes and edges flooded or impassable now.
+* rained and drained are the totals so far; up to rounding, rained == drained + the sum of depth.
+* A state is not thread-safe; give each thread its own.
+**/
+typedef struct {
+    int nodeCount;
+    int edgeCount;
+    int step;
+    double* depth;
+    double* next;
+    double* maxDepth;
+    int* floodStep;
+    unsigned char* impassable;
+    int* toggled;
+    int toggledCount;
+    int floodedNodes;
+    int impassableEdges;
+    double rained;
+    double drained;
+} flood_state_t;
+
+/**
+* Precomputes the runoff shares of the city's roads.
+* @param params The model parameters, or NULL for FLOOD_DEFAULT_PARAMS.
+* @return Pointer to the model, or NULL if memory allocation fails or
+* a parameter is out of range (runoff outside 0..1, drainage negative,
+* a threshold not positive).
+**/
+flood_model_t* createFloodModel(const city_t* city, const flood_params_t* params);
+
+/**
+* Frees a model. If the pointer is NULL, the function does nothing.
+**/
+void freeFloodModel(flood_model_t* model);
+
+/**
+* Creates a dry state for the model's city (see floodReset()).
+* @return Pointer to the state, or NULL if memory allocation fails.
+**/
+flood_state_t* createFloodState(const flood_model_t* model);
+
+/**
+* Returns a state to step 0: no water, nothing flooded.
+**/
+void floodReset(flood_state_t* state);
+
+/**
+* Frees a state. If the pointer is NULL, the function does nothing.
+**/
+void freeFloodState(flood_state_t* state);
+
+/**
+* Advances the state by one timestep: rain falls on every node
+* (rainfall mm, times footprint[v] if footprint is not NULL; neither
+* may be negative), the drains take up to drainage from each node,
+* runoff moves along the roads, and the flood and impassable marks are
+* brought up to date.
+* O(nodes + edges) over contiguous arrays.
+**/
+void floodStep(const flood_model_t* model, flood_state_t* state, double rainfall, const float* footprint);
+
+/**
+* Runs steps timesteps, with rainfall[i] mm falling in step i (the
+* storm's hyetograph), and footprint as for floodStep().
+**/
+void floodRun(const flood_model_t* model, flood_state_t* state, const double* rainfall, int steps,
+              const float* footprint);
+
+/**
+* Brings a routing overlay in line with the state's impassable roads
+* by closing (factor INFINITY) or reopening (factor 1) the edges
+* toggled in the last step, so it costs the number of roads that
+* changed. Call it after every floodStep() so no change is missed, and
+* clear the overlay with routeOverlayClear() after floodReset().
+**/
+void floodUpdateOverlay(const flood_state_t* state, route_overlay_t* overlay);
+
+/**
+* One storm of an ensemble. Rain rises linearly from 0 to peak mm per
+* step half way through duration steps and falls back to 0, then
+* stops. With radius > 0 the storm is a cell centred on (lat, lon):
+* node v gets exp(-(d / radius)^2 / 2) of it, d being its haversine()
+* distance from the centre; otherwise it rains on the whole city.
+**/
+typedef struct {
+    double peak;
+    int duration;
+    double lat;
+    double lon;
+    double radius;
+} flood_scenario_t;
+
+/**
+* Runs every scenario for steps timesteps over the model's city and
+* aggregates the results per node (nodeCount entries each): the
+* deepest water in any scenario (maxDepth), the number of scenarios in
+* which the node flooded (floodCount), and the earliest step at which
+* it did (firstFlood, -1 if never). Any output may be NULL.
+* Scenarios are handed out to up to threads worker threads (fewer than
+* 1 means 1). The model is shared read-only; each worker has its own
+* state, footprint and totals, which are merged once it runs out of
+* scenarios, so the results do not depend on the thread count.
+* @return 1 on success, 0 if memory or a thread could not be obtained.
+**/
+int floodEnsemble(const flood_model_t* model, const flood_scenario_t* scenarios, int count, int steps,
+                  int threads, double* maxDepth, int* floodCount, int* firstFlood);
+
+#endif
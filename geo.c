@@ -0,0 +1,388 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "geo.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define GEO_X86 1
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/*
+ * haversineMany() uses d = 2R asin(s) with s half the chord between
+ * unit vectors. For s <= ASIN_SERIES_MAX (about 800 km) the series
+ * asin(s) = s * sum(asin_series[k] s^2k) is exact to well below a
+ * double's precision with these terms; past it, or for NaN, the
+ * kernels fall back to haversine().
+ */
+#define ASIN_SERIES_MAX 0.0625
+#define ASIN_TERMS 7
+
+static const double asin_series[ASIN_TERMS] = {
+    1.0, 1.0 / 6.0, 3.0 / 40.0, 5.0 / 112.0, 35.0 / 1152.0, 63.0 / 2816.0, 231.0 / 13312.0
+};
+
+static double deg2rad(double d) {
+    return d * M_PI / 180.0;
+}
+
+void geoUnitVector(double lat, double lon, double* v) {
+    double phi = deg2rad(lat), lambda = deg2rad(lon);
+    v[0] = cos(phi) * cos(lambda);
+    v[1] = cos(phi) * sin(lambda);
+    v[2] = sin(phi);
+}
+
+double haversine(double lat1, double lon1, double lat2, double lon2) {
+    double R = EARTH_RADIUS_M;
+    double phi1 = deg2rad(lat1);
+    double phi2 = deg2rad(lat2);
+    double dphi = deg2rad(lat2 - lat1);
+    double dlambda = deg2rad(lon2 - lon1);
+
+    double a = sin(dphi/2.0) * sin(dphi/2.0) +
+               cos(phi1) * cos(phi2) *
+               sin(dlambda/2.0) * sin(dlambda/2.0);
+    double c = 2.0 * atan2(sqrt(a), sqrt(1 - a));
+    return R * c;
+}
+
+geo_points_t* createGeoPoints(int count) {
+    if (count < 0) return NULL;
+    geo_points_t *pts = malloc(sizeof(geo_points_t));
+    double *block = calloc(5 * (size_t) count + 1, sizeof(double));
+    if (!pts || !block) {
+        free(pts);
+        free(block);
+        return NULL;
+    }
+    pts->count = count;
+    pts->lat = block;
+    pts->lon = block + count;
+    pts->x = block + 2 * (size_t) count;
+    pts->y = block + 3 * (size_t) count;
+    pts->z = block + 4 * (size_t) count;
+    for (int i = 0; i < count; ++i) pts->x[i] = 1.0;
+    return pts;
+}
+
+void geoPointsSet(geo_points_t* pts, int i, double lat, double lon) {
+    double v[3];
+    geoUnitVector(lat, lon, v);
+    pts->lat[i] = lat;
+    pts->lon[i] = lon;
+    pts->x[i] = v[0];
+    pts->y[i] = v[1];
+    pts->z[i] = v[2];
+}
+
+void freeGeoPoints(geo_points_t* pts) {
+    if (!pts) return;
+    free(pts->lat);
+    free(pts);
+}
+
+// One point of haversineMany(); the vector kernels do the same
+// operations in the same order, so every kernel gives the same bits.
+static double many_one(const geo_points_t *pts, int j, const double *q, double lat, double lon) {
+    double dx = q[0] - pts->x[j], dy = q[1] - pts->y[j], dz = q[2] - pts->z[j];
+    double s = 0.5 * sqrt(dx*dx + dy*dy + dz*dz);
+    if (!(s <= ASIN_SERIES_MAX)) return haversine(lat, lon, pts->lat[j], pts->lon[j]);
+    double s2 = s * s, p = asin_series[ASIN_TERMS - 1];
+    for (int k = ASIN_TERMS - 2; k >= 0; --k) p = p * s2 + asin_series[k];
+    return 2.0 * EARTH_RADIUS_M * s * p;
+}
+
+static void many_scalar(const geo_points_t *pts, int first, int count, const double *q, double lat, double lon, double *out) {
+    for (int i = 0; i < count; ++i) out[i] = many_one(pts, first + i, q, lat, lon);
+}
+
+#ifdef GEO_X86
+/*
+ * The upper halves of the AVX registers are cleared before calling
+ * haversine() or returning: libm's SSE code would otherwise pay for the
+ * mixed register state on every instruction, and without optimisation
+ * gcc does not insert vzeroupper itself.
+ */
+__attribute__((target("avx")))
+static void many_avx(const geo_points_t *pts, int first, int count, const double *q, double lat, double lon, double *out) {
+    __m256d qx = _mm256_set1_pd(q[0]), qy = _mm256_set1_pd(q[1]), qz = _mm256_set1_pd(q[2]);
+    __m256d half = _mm256_set1_pd(0.5), bound = _mm256_set1_pd(ASIN_SERIES_MAX);
+    __m256d twoR = _mm256_set1_pd(2.0 * EARTH_RADIUS_M);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int j = first + i;
+        __m256d dx = _mm256_sub_pd(qx, _mm256_loadu_pd(pts->x + j));
+        __m256d dy = _mm256_sub_pd(qy, _mm256_loadu_pd(pts->y + j));
+        __m256d dz = _mm256_sub_pd(qz, _mm256_loadu_pd(pts->z + j));
+        __m256d c2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(dz, dz));
+        __m256d s = _mm256_mul_pd(half, _mm256_sqrt_pd(c2));
+        __m256d s2 = _mm256_mul_pd(s, s);
+        __m256d p = _mm256_set1_pd(asin_series[ASIN_TERMS - 1]);
+        for (int k = ASIN_TERMS - 2; k >= 0; --k) p = _mm256_add_pd(_mm256_mul_pd(p, s2), _mm256_set1_pd(asin_series[k]));
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_mul_pd(twoR, s), p));
+        int far = _mm256_movemask_pd(_mm256_cmp_pd(s, bound, _CMP_NLE_UQ));
+        if (far) _mm256_zeroupper();
+        while (far) {
+            int l = __builtin_ctz(far);
+            far &= far - 1;
+            out[i + l] = haversine(lat, lon, pts->lat[j + l], pts->lon[j + l]);
+        }
+    }
+    _mm256_zeroupper();
+    many_scalar(pts, first + i, count - i, q, lat, lon, out + i);
+}
+
+__attribute__((target("sse2")))
+static void many_sse2(const geo_points_t *pts, int first, int count, const double *q, double lat, double lon, double *out) {
+    __m128d qx = _mm_set1_pd(q[0]), qy = _mm_set1_pd(q[1]), qz = _mm_set1_pd(q[2]);
+    __m128d half = _mm_set1_pd(0.5), bound = _mm_set1_pd(ASIN_SERIES_MAX);
+    __m128d twoR = _mm_set1_pd(2.0 * EARTH_RADIUS_M);
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        int j = first + i;
+        __m128d dx = _mm_sub_pd(qx, _mm_loadu_pd(pts->x + j));
+        __m128d dy = _mm_sub_pd(qy, _mm_loadu_pd(pts->y + j));
+        __m128d dz = _mm_sub_pd(qz, _mm_loadu_pd(pts->z + j));
+        __m128d c2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz));
+        __m128d s = _mm_mul_pd(half, _mm_sqrt_pd(c2));
+        __m128d s2 = _mm_mul_pd(s, s);
+        __m128d p = _mm_set1_pd(asin_series[ASIN_TERMS - 1]);
+        for (int k = ASIN_TERMS - 2; k >= 0; --k) p = _mm_add_pd(_mm_mul_pd(p, s2), _mm_set1_pd(asin_series[k]));
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_mul_pd(twoR, s), p));
+        int far = _mm_movemask_pd(_mm_cmpnle_pd(s, bound));
+        if (far & 1) out[i] = haversine(lat, lon, pts->lat[j], pts->lon[j]);
+        if (far & 2) out[i + 1] = haversine(lat, lon, pts->lat[j + 1], pts->lon[j + 1]);
+    }
+    many_scalar(pts, first + i, count - i, q, lat, lon, out + i);
+}
+#endif
+
+void haversineMany(const geo_points_t* pts, int first, int count, double lat, double lon, double* out) {
+    double q[3];
+    geoUnitVector(lat, lon, q);
+#ifdef GEO_X86
+    if (__builtin_cpu_supports("avx")) { many_avx(pts, first, count, q, lat, lon, out); return; }
+    if (__builtin_cpu_supports("sse2")) { many_sse2(pts, first, count, q, lat, lon, out); return; }
+#endif
+    many_scalar(pts, first, count, q, lat, lon, out);
+}
+
+const char* haversineManyKernel(void) {
+#ifdef GEO_X86
+    if (__builtin_cpu_supports("avx")) return "avx";
+    if (__builtin_cpu_supports("sse2")) return "sse2";
+#endif
+    return "scalar";
+}
+
+double geoDiameterBruteForce(const city_poi_t* pts, int n, int* a, int* b) {
+    double best = -1.0;
+    *a = *b = -1;
+    geo_points_t *soa = createGeoPoints(n);
+    double *row = malloc(sizeof(double) * (n > 0 ? n : 1));
+    if (!soa || !row) {
+        freeGeoPoints(soa); free(row);
+        soa = NULL; row = NULL;
+    }
+    for (int i = 0; soa && i < n; ++i) geoPointsSet(soa, i, pts[i].lat, pts[i].lon);
+
+    for (int i = 0; i < n; ++i) {
+        // haversineMany() is within GEO_MANY_TOLERANCE_M of haversine(), so
+        // only pairs it puts near or above the best need the exact distance.
+        if (soa) haversineMany(soa, i + 1, n - i - 1, pts[i].lat, pts[i].lon, row);
+        for (int j = i + 1; j < n; ++j) {
+            if (soa && !(row[j - i - 1] > best - GEO_MANY_TOLERANCE_M)) continue;
+            double d = haversine(pts[i].lat, pts[i].lon, pts[j].lat, pts[j].lon);
+            if (d > best) { best = d; *a = i; *b = j; }
+        }
+    }
+    freeGeoPoints(soa);
+    free(row);
+    return best;
+}
+
+typedef struct {
+    double x, y;
+    int idx;
+} pt2_t;
+
+static double cross(const pt2_t *o, const pt2_t *a, const pt2_t *b) {
+    return (a->x - o->x) * (b->y - o->y) - (a->y - o->y) * (b->x - o->x);
+}
+
+static int cmp_pt2(const void *pa, const void *pb) {
+    const pt2_t *a = pa, *b = pb;
+    if (a->x != b->x) return a->x < b->x ? -1 : 1;
+    if (a->y != b->y) return a->y < b->y ? -1 : 1;
+    return 0;
+}
+
+// Andrew's monotone chain; sorts p and writes the counter-clockwise hull
+// (without collinear points) to hull, which needs room for 2n points.
+// Coordinates must be finite: a NaN cross product never pops.
+static int convex_hull(pt2_t *p, int n, pt2_t *hull) {
+    qsort(p, n, sizeof(pt2_t), cmp_pt2);
+    int k = 0;
+    for (int i = 0; i < n; ++i) {
+        while (k >= 2 && cross(&hull[k-2], &hull[k-1], &p[i]) <= 0) k--;
+        hull[k++] = p[i];
+    }
+    for (int i = n - 2, lower = k + 1; i >= 0; --i) {
+        while (k >= lower && cross(&hull[k-2], &hull[k-1], &p[i]) <= 0) k--;
+        hull[k++] = p[i];
+    }
+    return k > 1 ? k - 1 : k;
+}
+
+static void consider(const city_poi_t *pts, int i, int j, double *best) {
+    if (i == j) return;
+    double d = haversine(pts[i].lat, pts[i].lon, pts[j].lat, pts[j].lon);
+    if (d > *best) *best = d;
+}
+
+// Lower bound on the diameter from the hull's antipodal vertex pairs.
+static double calipers(const city_poi_t *pts, const pt2_t *h, int m) {
+    double best = -1.0;
+    if (m == 2) consider(pts, h[0].idx, h[1].idx, &best);
+    if (m < 3) return best;
+    int j = 1;
+    for (int i = 0; i < m; ++i) {
+        int ni = (i + 1) % m;
+        while (cross(&h[i], &h[ni], &h[(j + 1) % m]) > cross(&h[i], &h[ni], &h[j])) j = (j + 1) % m;
+        consider(pts, h[i].idx, h[j].idx, &best);
+        consider(pts, h[ni].idx, h[j].idx, &best);
+    }
+    return best;
+}
+
+// geoDiameter() over points whose coordinates are all finite.
+static double finite_diameter(const city_poi_t* pts, int n, int* a, int* b) {
+    if (n < 16) return geoDiameterBruteForce(pts, n, a, b);
+
+    double *xyz = malloc(sizeof(double) * 3 * n);
+    pt2_t *flat = malloc(sizeof(pt2_t) * n);
+    pt2_t *sorted = malloc(sizeof(pt2_t) * n);
+    pt2_t *hull = malloc(sizeof(pt2_t) * 2 * n);
+    int *keep = malloc(sizeof(int) * n);
+    if (!xyz || !flat || !sorted || !hull || !keep) {
+        free(xyz); free(flat); free(sorted); free(hull); free(keep);
+        return geoDiameterBruteForce(pts, n, a, b);
+    }
+
+    // Unit vectors; the chord between two of them grows with haversine().
+    double c[3] = {0.0, 0.0, 0.0};
+    for (int i = 0; i < n; ++i) {
+        double *v = &xyz[3 * i];
+        geoUnitVector(pts[i].lat, pts[i].lon, v);
+        c[0] += v[0]; c[1] += v[1]; c[2] += v[2];
+    }
+    double len = sqrt(c[0]*c[0] + c[1]*c[1] + c[2]*c[2]);
+    if (len < 1e-12) memcpy(c, xyz, sizeof(c));
+    else { c[0] /= len; c[1] /= len; c[2] /= len; }
+
+    // Orthonormal basis (e1, e2) of the plane tangent at c.
+    double axis[3] = {0.0, 0.0, 0.0};
+    axis[fabs(c[0]) < fabs(c[1]) ? (fabs(c[0]) < fabs(c[2]) ? 0 : 2) : (fabs(c[1]) < fabs(c[2]) ? 1 : 2)] = 1.0;
+    double e1[3] = {c[1]*axis[2] - c[2]*axis[1], c[2]*axis[0] - c[0]*axis[2], c[0]*axis[1] - c[1]*axis[0]};
+    len = sqrt(e1[0]*e1[0] + e1[1]*e1[1] + e1[2]*e1[2]);
+    e1[0] /= len; e1[1] /= len; e1[2] /= len;
+    double e2[3] = {c[1]*e1[2] - c[2]*e1[1], c[2]*e1[0] - c[0]*e1[2], c[0]*e1[1] - c[1]*e1[0]};
+
+    double hmin = INFINITY, hmax = -INFINITY;
+    for (int i = 0; i < n; ++i) {
+        const double *v = &xyz[3 * i];
+        double h = v[0]*c[0] + v[1]*c[1] + v[2]*c[2];
+        if (h < hmin) hmin = h;
+        if (h > hmax) hmax = h;
+        flat[i] = (pt2_t){v[0]*e1[0] + v[1]*e1[1] + v[2]*e1[2], v[0]*e2[0] + v[1]*e2[1] + v[2]*e2[2], i};
+    }
+
+    // The hull sorts its input; flat stays in index order so the final
+    // pass matches the brute force's tie-break.
+    memcpy(sorted, flat, sizeof(pt2_t) * n);
+    int m = convex_hull(sorted, n, hull);
+    double lower = calipers(pts, hull, m);
+
+    /*
+     * For unit vectors p, q: |p-q|^2 = |proj(p-q)|^2 + ((p-q).c)^2, and
+     * the second term is at most (hmax-hmin)^2. So a pair at least as far
+     * apart as the candidate needs a projected distance of at least t,
+     * and each endpoint must have some hull vertex at least t away.
+     * The slack absorbs rounding between the two distance formulas.
+     */
+    double chord = 2.0 * sin(lower / (2.0 * EARTH_RADIUS_M));
+    double dh = hmax - hmin;
+    double t2 = lower < 0.0 ? -1.0 : chord * chord * (1.0 - 1e-9) - dh * dh - 1e-18;
+
+    double mx = 0.0, my = 0.0, rmax = 0.0;
+    for (int i = 0; i < m; ++i) { mx += hull[i].x; my += hull[i].y; }
+    mx /= m; my /= m;
+    for (int i = 0; i < m; ++i) {
+        double r = hypot(hull[i].x - mx, hull[i].y - my);
+        if (r > rmax) rmax = r;
+    }
+
+    int kept = 0;
+    for (int i = 0; i < n; ++i) {
+        const pt2_t *p = &flat[i];
+        double u = hypot(p->x - mx, p->y - my) + rmax;
+        if (u * u < t2) continue;
+        double far2 = 0.0;
+        for (int k = 0; k < m && far2 < t2; ++k) {
+            double dx = p->x - hull[k].x, dy = p->y - hull[k].y;
+            if (dx*dx + dy*dy > far2) far2 = dx*dx + dy*dy;
+        }
+        if (far2 >= t2) keep[kept++] = i;
+    }
+
+    double best = -1.0;
+    *a = *b = -1;
+    for (int x = 0; x < kept; ++x) {
+        const city_poi_t *pi = &pts[keep[x]];
+        for (int y = x + 1; y < kept; ++y) {
+            const city_poi_t *pj = &pts[keep[y]];
+            double d = haversine(pi->lat, pi->lon, pj->lat, pj->lon);
+            if (d > best) { best = d; *a = keep[x]; *b = keep[y]; }
+        }
+    }
+
+    free(xyz);
+    free(flat);
+    free(sorted);
+    free(hull);
+    free(keep);
+    return best;
+}
+
+/*
+ * haversine() is NaN for a point with a non-finite coordinate, so the
+ * brute force never picks one; they are left out here too (as from the
+ * spatial index) and the pair is mapped back to the caller's indices.
+ */
+double geoDiameter(const city_poi_t* pts, int n, int* a, int* b) {
+    int finite = 0;
+    for (int i = 0; i < n; ++i) finite += isfinite(pts[i].lat) && isfinite(pts[i].lon);
+    if (finite == n) return finite_diameter(pts, n, a, b);
+
+    city_poi_t *sub = malloc(sizeof(city_poi_t) * (finite + 1));
+    int *index = malloc(sizeof(int) * (finite + 1));
+    if (!sub || !index) {
+        free(sub); free(index);
+        return geoDiameterBruteForce(pts, n, a, b);
+    }
+    for (int i = 0, k = 0; i < n; ++i) {
+        if (!isfinite(pts[i].lat) || !isfinite(pts[i].lon)) continue;
+        sub[k] = pts[i];
+        index[k++] = i;
+    }
+    double best = finite_diameter(sub, finite, a, b);
+    if (*a >= 0) { *a = index[*a]; *b = index[*b]; }
+    free(sub);
+    free(index);
+    return best;
+}
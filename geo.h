@@ -0,0 +1,101 @@
+#ifndef GEO_H
+#define GEO_H
+
+#include "city.h"
+
+#define EARTH_RADIUS_M 6371000.0
+
+/**
+* haversineMany() results are within this many meters of haversine()
+* for the same pair of points.
+**/
+#define GEO_MANY_TOLERANCE_M 1e-6
+
+/**
+* Points stored as a structure of arrays for haversineMany(): the
+* coordinates in degrees and, in separate contiguous arrays, the unit
+* vector (cos(lat) cos(lon), cos(lat) sin(lon), sin(lat)) of each.
+**/
+typedef struct {
+    int count;
+    double* lat;
+    double* lon;
+    double* x;
+    double* y;
+    double* z;
+} geo_points_t;
+
+/**
+* Writes to v the unit vector (cos(lat) cos(lon), cos(lat) sin(lon),
+* sin(lat)) of a point given in degrees. The k-d tree, geo_points_t
+* and geoDiameter() all use it, so their coordinates agree bit for bit.
+**/
+void geoUnitVector(double lat, double lon, double* v);
+
+/**
+* Great-circle distance in meters between two points given in degrees,
+* using the haversine formula on a sphere of radius EARTH_RADIUS_M.
+**/
+double haversine(double lat1, double lon1, double lat2, double lon2);
+
+/**
+* Creates a point store with room for count points, all at (0, 0)
+* until set with geoPointsSet().
+* @return Pointer to the store, or NULL if memory allocation fails.
+**/
+geo_points_t* createGeoPoints(int count);
+
+/**
+* Sets point i of the store to (lat, lon) in degrees.
+**/
+void geoPointsSet(geo_points_t* pts, int i, double lat, double lon);
+
+/**
+* Frees a point store. If pts is NULL, the function does nothing.
+**/
+void freeGeoPoints(geo_points_t* pts);
+
+/**
+* Writes to out[i] the distance in meters from (lat, lon) to point
+* first + i of pts, for i < count, like haversine() but several points
+* at a time with AVX or SSE2 when the CPU has them.
+* Distances come from the chord between unit vectors through a series
+* for asin(), which needs no trigonometry per point; points more than
+* about 800 km away (or with non-finite coordinates) go through
+* haversine() instead. Results are within GEO_MANY_TOLERANCE_M of
+* haversine(), and are the same whichever instruction set is used.
+**/
+void haversineMany(const geo_points_t* pts, int first, int count, double lat, double lon, double* out);
+
+/**
+* Name of the instruction set haversineMany() uses on this CPU:
+* "avx", "sse2" or "scalar".
+**/
+const char* haversineManyKernel(void);
+
+/**
+* Finds the two points farthest apart by haversine() by checking every
+* pair. O(n^2); kept as the reference for geoDiameter().
+* haversineMany() rules out the pairs that cannot beat the best so far,
+* so haversine() only runs for the rest; the result is the same.
+* @param a, b Receive the pair's indices (a < b).
+* @return The distance in meters, or -1 if there are fewer than two points.
+* Ties go to the first pair in (a, b) order.
+**/
+double geoDiameterBruteForce(const city_poi_t* pts, int n, int* a, int* b);
+
+/**
+* Same result as geoDiameterBruteForce() (pair, distance and tie-break)
+* without checking every pair. Points with a non-finite coordinate are
+* never part of the pair and are left out before the hull is built.
+* Points are projected onto the plane tangent to the sphere at their
+* mean direction. Rotating calipers over the planar convex hull give a
+* candidate pair, and the projection error bound then rules out every
+* point that cannot be part of a pair at least that far apart; only the
+* remaining points are compared exactly.
+* Typically O(n h) for a hull of h vertices; it degrades towards the
+* brute force only when most points lie on or near the hull.
+**/
+double geoDiameter(const city_poi_t* pts, int n, int* a, int* b);
+
+#endif
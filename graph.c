@@ -2,6 +2,144 @@
 #include <string.h>
 
 #define INITIAL_NODE_CAPACITY 100
+#define INITIAL_INDEX_CAPACITY 256
+#define NODES_PER_BLOCK 256
+#define EDGES_PER_BLOCK 1024
+#define ARENA_BLOCK_SIZE 65536
+// Every block starts with a link to the next block, padded to this size.
+#define BLOCK_HEADER 16
+// Data records hold at most doubles and pointers.
+#define DATA_ALIGN 8
+
+// Hash index: linear probing over a power-of-two table, slot -1 marks empty.
+static unsigned int hash_id(int id) {
+    unsigned int h = (unsigned int) id;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static int index_find(graph_t* graph, int id) {
+    unsigned int mask = (unsigned int) graph->idIndexSpace - 1;
+    unsigned int i = hash_id(id) & mask;
+    while (graph->idIndex[i].slot != -1) {
+        if (graph->idIndex[i].id == id)
+            return (int) i;
+        i = (i + 1) & mask;
+    }
+    return -1;
+}
+
+static void index_put(id_slot_t* table, int space, int id, int slot) {
+    unsigned int mask = (unsigned int) space - 1;
+    unsigned int i = hash_id(id) & mask;
+    while (table[i].slot != -1 && table[i].id != id)
+        i = (i + 1) & mask;
+    table[i].id = id;
+    table[i].slot = slot;
+}
+
+static id_slot_t* index_alloc(int space) {
+    id_slot_t* table = malloc(space * sizeof(id_slot_t));
+    if (!table) return NULL;
+    for (int i = 0; i < space; i++)
+        table[i].slot = -1;
+    return table;
+}
+
+// Keeps the table at most half full so probe sequences stay short.
+static int index_reserve(graph_t* graph, int count) {
+    if (count * 2 <= graph->idIndexSpace) return 1;
+
+    int space = graph->idIndexSpace * 2;
+    while (count * 2 > space) space *= 2;
+    id_slot_t* table = index_alloc(space);
+    if (!table) return 0;
+
+    for (int i = 0; i < graph->idIndexSpace; i++) {
+        if (graph->idIndex[i].slot != -1)
+            index_put(table, space, graph->idIndex[i].id, graph->idIndex[i].slot);
+    }
+    free(graph->idIndex);
+    graph->idIndex = table;
+    graph->idIndexSpace = space;
+    return 1;
+}
+
+// Backward-shift deletion, so no tombstones are left behind.
+static void index_remove(graph_t* graph, int id) {
+    int hole = index_find(graph, id);
+    if (hole == -1) return;
+
+    unsigned int mask = (unsigned int) graph->idIndexSpace - 1;
+    unsigned int i = (unsigned int) hole;
+    unsigned int j = i;
+    while (1) {
+        j = (j + 1) & mask;
+        if (graph->idIndex[j].slot == -1) break;
+        unsigned int home = hash_id(graph->idIndex[j].id) & mask;
+        // Move j into the hole unless its home lies cyclically in (i, j].
+        if ((i <= j) ? (i < home && home <= j) : (i < home || home <= j))
+            continue;
+        graph->idIndex[i] = graph->idIndex[j];
+        i = j;
+    }
+    graph->idIndex[i].slot = -1;
+}
+
+static size_t round_up(size_t size) {
+    return (size + BLOCK_HEADER - 1) & ~(size_t)(BLOCK_HEADER - 1);
+}
+
+static void* block_new(void** blocks, size_t size) {
+    char* block = malloc(BLOCK_HEADER + size);
+    if (!block) return NULL;
+    *(void**) block = *blocks;
+    *blocks = block;
+    return block + BLOCK_HEADER;
+}
+
+static void blocks_release(void* blocks) {
+    while (blocks) {
+        void* next = *(void**) blocks;
+        free(blocks);
+        blocks = next;
+    }
+}
+
+static void slab_init(slab_t* slab, size_t objectSize, int perBlock) {
+    slab->objectSize = round_up(objectSize);
+    slab->perBlock = perBlock;
+    slab->blocks = NULL;
+    slab->next = NULL;
+    slab->left = 0;
+    slab->freeList = NULL;
+}
+
+static void* slab_alloc(slab_t* slab) {
+    if (slab->freeList) {
+        void* obj = slab->freeList;
+        slab->freeList = *(void**) obj;
+        return obj;
+    }
+    if (slab->left == 0) {
+        slab->next = block_new(&slab->blocks, slab->objectSize * slab->perBlock);
+        if (!slab->next) return NULL;
+        slab->left = slab->perBlock;
+    }
+    void* obj = slab->next;
+    slab->next += slab->objectSize;
+    slab->left--;
+    return obj;
+}
+
+static void slab_free(slab_t* slab, void* obj) {
+    *(void**) obj = slab->freeList;
+    slab->freeList = obj;
+}
 
 graph_t* createGraph() {
     graph_t* g = malloc(sizeof(graph_t));
@@ -14,35 +152,61 @@ graph_t* createGraph() {
         free(g);
         return NULL;
     }
+    g->idIndexSpace = INITIAL_INDEX_CAPACITY;
+    g->idIndex = index_alloc(g->idIndexSpace);
+    if (!g->idIndex) {
+        free(g->nodes);
+        free(g);
+        return NULL;
+    }
+    slab_init(&g->nodeSlab, sizeof(node_t), NODES_PER_BLOCK);
+    slab_init(&g->edgeSlab, sizeof(edge_t), EDGES_PER_BLOCK);
+    g->dataArena.blocks = NULL;
+    g->dataArena.next = NULL;
+    g->dataArena.left = 0;
     return g;
 }
 
 void freeGraph(graph_t* graph) {
     if (!graph) return;
 
-    for (int i = 0; i < graph->nodeCount; i++) {
-        node_t* node = graph->nodes[i];
-        if (!node) continue;
+    blocks_release(graph->nodeSlab.blocks);
+    blocks_release(graph->edgeSlab.blocks);
+    blocks_release(graph->dataArena.blocks);
+    free(graph->nodes);
+    free(graph->idIndex);
+    free(graph);
+}
 
-        edge_t* e = node->edges;
-        while (e) {
-            edge_t* next = e->next;
-            free(e);
-            e = next;
+void* graphAlloc(graph_t* graph, size_t size) {
+    arena_t* arena = &graph->dataArena;
+    size = (size + DATA_ALIGN - 1) & ~(size_t)(DATA_ALIGN - 1);
+    if (size == 0) size = DATA_ALIGN;
+    // Large requests get their own block so the current one is not wasted.
+    if (size > ARENA_BLOCK_SIZE / 4) {
+        void* mem = block_new(&arena->blocks, size);
+        if (mem) memset(mem, 0, size);
+        return mem;
+    }
+    if (arena->left < size) {
+        arena->next = block_new(&arena->blocks, ARENA_BLOCK_SIZE);
+        if (!arena->next) {
+            arena->left = 0;
+            return NULL;
         }
-        free(node->data);
-        free(node);
+        arena->left = ARENA_BLOCK_SIZE;
     }
-    free(graph->nodes);
-    free(graph);
+    void* mem = arena->next;
+    arena->next += size;
+    arena->left -= size;
+    memset(mem, 0, size);
+    return mem;
 }
 
 node_t* getNode(graph_t* graph, int id) {
-    for (int i = 0; i < graph->nodeCount; i++) {
-        if (graph->nodes[i]->id == id)
-            return graph->nodes[i];
-    }
-    return NULL;
+    int i = index_find(graph, id);
+    if (i == -1) return NULL;
+    return graph->nodes[graph->idIndex[i].slot];
 }
 
 // Add node
@@ -55,13 +219,16 @@ node_t* addNode(graph_t* graph, int id, void* data) {
         if (!newArr) return NULL;
         graph->nodes = newArr;
     }
+    if (!index_reserve(graph, graph->nodeCount + 1)) return NULL;
 
-    node_t* n = malloc(sizeof(node_t));
+    node_t* n = slab_alloc(&graph->nodeSlab);
     if (!n) return NULL;
     n->id = id;
+    n->index = graph->nodeCount;
     n->data = data;
     n->edges = NULL;
 
+    index_put(graph->idIndex, graph->idIndexSpace, id, graph->nodeCount);
     graph->nodes[graph->nodeCount++] = n;
     return n;
 }
@@ -78,7 +245,7 @@ edge_t* addEdge(graph_t* graph, int fromId, int toId, float weight, void* data)
         curr = curr->next;
     }
 
-    edge_t* e = malloc(sizeof(edge_t));
+    edge_t* e = slab_alloc(&graph->edgeSlab);
     if (!e) return NULL;
     e->toNode = toNode;
     e->weight = weight;
@@ -114,7 +281,7 @@ int removeEdge(graph_t* graph, int fromId, int toId) {
         if (curr->toNode->id == toId) {
             if (prev) prev->next = curr->next;
             else fromNode->edges = curr->next;
-            free(curr);
+            slab_free(&graph->edgeSlab, curr);
             graph->edgeCount--;
             return 1;
         }
@@ -125,28 +292,43 @@ int removeEdge(graph_t* graph, int fromId, int toId) {
 }
 
 int removeNode(graph_t* graph, int id) {
-    int index = -1;
-    for (int i = 0; i < graph->nodeCount; i++) {
-        if (graph->nodes[i]->id == id) {
-            index = i;
-            break;
-        }
-    }
-    if (index == -1) return 0;
+    int entry = index_find(graph, id);
+    if (entry == -1) return 0;
+    int index = graph->idIndex[entry].slot;
+    index_remove(graph, id);
 
     node_t* node = graph->nodes[index];
     edge_t* e = node->edges;
     while (e) {
         edge_t* next = e->next;
-        free(e);
+        slab_free(&graph->edgeSlab, e);
+        graph->edgeCount--;
         e = next;
     }
+    node->edges = NULL;
 
-    free(node->data);
-    free(node);
+    // Drop edges from other nodes into the removed one.
+    for (int i = 0; i < graph->nodeCount; i++) {
+        edge_t** link = &graph->nodes[i]->edges;
+        while (*link) {
+            if ((*link)->toNode == node) {
+                edge_t* dead = *link;
+                *link = dead->next;
+                slab_free(&graph->edgeSlab, dead);
+                graph->edgeCount--;
+            } else {
+                link = &(*link)->next;
+            }
+        }
+    }
+
+    slab_free(&graph->nodeSlab, node);
 
-    for (int i = index; i < graph->nodeCount - 1; i++)
+    for (int i = index; i < graph->nodeCount - 1; i++) {
         graph->nodes[i] = graph->nodes[i + 1];
+        graph->nodes[i]->index = i;
+        index_put(graph->idIndex, graph->idIndexSpace, graph->nodes[i]->id, i);
+    }
 
     graph->nodeCount--;
     return 1;
@@ -167,6 +349,88 @@ void printGraph(graph_t* graph) {
     }
 }
 
+csr_graph_t* freezeGraph(graph_t* graph) {
+    if (!graph) return NULL;
+    csr_graph_t* csr = calloc(1, sizeof(csr_graph_t));
+    if (!csr) return NULL;
+
+    int n = graph->nodeCount;
+    int m = graph->edgeCount;
+    csr->nodeCount = n;
+    csr->edgeCount = m;
+    csr->ids = malloc((n + 1) * sizeof(int));
+    csr->nodeData = malloc((n + 1) * sizeof(void*));
+    csr->offsets = malloc((n + 1) * sizeof(int));
+    csr->targets = malloc((m + 1) * sizeof(int));
+    csr->weights = malloc((m + 1) * sizeof(float));
+    csr->edgeData = malloc((m + 1) * sizeof(void*));
+    csr->revOffsets = malloc((n + 1) * sizeof(int));
+    csr->revSources = malloc((m + 1) * sizeof(int));
+    csr->revWeights = malloc((m + 1) * sizeof(float));
+    if (!csr->ids || !csr->nodeData || !csr->offsets ||
+        !csr->targets || !csr->weights || !csr->edgeData ||
+        !csr->revOffsets || !csr->revSources || !csr->revWeights) {
+        freeFrozenGraph(csr);
+        return NULL;
+    }
+
+    int k = 0;
+    for (int i = 0; i < n; i++) {
+        node_t* node = graph->nodes[i];
+        csr->ids[i] = node->id;
+        csr->nodeData[i] = node->data;
+        csr->offsets[i] = k;
+        for (edge_t* e = node->edges; e; e = e->next) {
+            if (k == m) {
+                freeFrozenGraph(csr);
+                return NULL;
+            }
+            csr->targets[k] = e->toNode->index;
+            csr->weights[k] = e->weight;
+            csr->edgeData[k] = e->data;
+            k++;
+        }
+    }
+    csr->offsets[n] = k;
+    csr->edgeCount = k;
+    csrReverse(n, csr->offsets, csr->targets, csr->weights,
+               csr->revOffsets, csr->revSources, csr->revWeights);
+    return csr;
+}
+
+void csrReverse(int nodeCount, const int* offsets, const int* targets, const float* weights,
+                int* revOffsets, int* revSources, float* revWeights) {
+    int m = offsets[nodeCount];
+    memset(revOffsets, 0, (nodeCount + 1) * sizeof(int));
+    for (int k = 0; k < m; k++) revOffsets[targets[k] + 1]++;
+    for (int i = 0; i < nodeCount; i++) revOffsets[i + 1] += revOffsets[i];
+
+    // revOffsets[v] is used as the fill cursor for v, then restored.
+    for (int u = 0; u < nodeCount; u++) {
+        for (int k = offsets[u]; k < offsets[u + 1]; k++) {
+            int at = revOffsets[targets[k]]++;
+            revSources[at] = u;
+            revWeights[at] = weights[k];
+        }
+    }
+    for (int i = nodeCount; i > 0; i--) revOffsets[i] = revOffsets[i - 1];
+    revOffsets[0] = 0;
+}
+
+void freeFrozenGraph(csr_graph_t* csr) {
+    if (!csr) return;
+    free(csr->ids);
+    free(csr->nodeData);
+    free(csr->offsets);
+    free(csr->targets);
+    free(csr->weights);
+    free(csr->edgeData);
+    free(csr->revOffsets);
+    free(csr->revSources);
+    free(csr->revWeights);
+    free(csr);
+}
+
 
 
 
@@ -16,17 +16,72 @@ struct edge {
 
 struct node {
     int id;
+    int index;
     void* data;
     edge_t* edges;
 };
 
+typedef struct {
+    int id;
+    int slot;
+} id_slot_t;
+
+/* Fixed-size object allocator: objects are carved out of large blocks
+   and freed objects go on a free list for reuse. */
+typedef struct {
+    size_t objectSize;
+    int perBlock;
+    void* blocks;
+    char* next;
+    int left;
+    void* freeList;
+} slab_t;
+
+/* Bump allocator for node and edge data, released all at once. */
+typedef struct {
+    void* blocks;
+    char* next;
+    size_t left;
+} arena_t;
+
 typedef struct {
     node_t** nodes;
     int nodeCount;
     int edgeCount;
     int nodeSpace;
+    id_slot_t* idIndex;
+    int idIndexSpace;
+    slab_t nodeSlab;
+    slab_t edgeSlab;
+    arena_t dataArena;
 } graph_t;
 
+/**
+* Immutable compressed sparse row (CSR) view of a graph_t.
+* Nodes are numbered 0..nodeCount-1 in the order of graph->nodes.
+* The outgoing edges of node i are the entries
+* offsets[i] .. offsets[i+1]-1 of targets, weights and edgeData,
+* so walking a node's edges is a linear scan over contiguous arrays.
+* Node and edge data pointers are shared with the source graph,
+* which must outlive the frozen view.
+* The reverse adjacency lists the incoming edges of node i as entries
+* revOffsets[i] .. revOffsets[i+1]-1 of revSources (the edge's tail)
+* and revWeights, in increasing order of tail.
+**/
+typedef struct {
+    int nodeCount;
+    int edgeCount;
+    int* ids;
+    void** nodeData;
+    int* offsets;
+    int* targets;
+    float* weights;
+    void** edgeData;
+    int* revOffsets;
+    int* revSources;
+    float* revWeights;
+} csr_graph_t;
+
 /**
 * Creates a new graph and returns a pointer to it. T
 * The graph is initialized with no nodes or edges,
@@ -39,21 +94,48 @@ typedef struct {
 * it behaves like an ArrayList in Java, where if the list is
 * full, the list of node pointers is expanded to double its size
 * and then a new node pointer is added.
+* Node IDs are also kept in an open-addressing hash index
+* (idIndex) that maps each ID to its slot in the node array,
+* so looking up a node by ID does not scan the array.
+* Every node also records its position in the node array in
+* node->index; indices stay dense (0..nodeCount-1) and are
+* updated when a node is removed, so edge targets can be
+* turned into array positions in O(1).
+* Nodes and edges are allocated from graph-owned slabs, so removed
+* ones are recycled through free lists, and node/edge data should be
+* allocated with graphAlloc() so it is released together with the graph.
+* The graph never calls free() on a data pointer: data allocated any
+* other way stays owned by the caller, who must free it after the node
+* or edge is removed or the graph is freed.
 **/
 graph_t* createGraph();
 
 /**
 * Frees the memory used by the graph.
-* All nodes and edges in the graph are also freed.
+* All nodes and edges in the graph are also freed, together with all
+* data allocated by graphAlloc(). This releases whole blocks and does
+* not visit individual nodes or edges, so node->data that did not come
+* from graphAlloc() is not freed.
 * If the graph pointer is NULL, the function does nothing.
 **/
 void freeGraph(graph_t* graph);
 
+/**
+* Allocates zeroed memory for node or edge data from the graph's arena.
+* @param graph Pointer to the graph.
+* @param size Number of bytes needed.
+* @return Pointer to the memory, or NULL on failure.
+* The memory stays valid until freeGraph(); removing the node or edge
+* that uses it does not release it.
+**/
+void* graphAlloc(graph_t* graph, size_t size);
+
 /**
 * Adds a new node to the graph.
 * @param graph Pointer to the graph.
 * @param id Unique identifier for the new node.
-* @param data Pointer to additional node data.
+* @param data Pointer to additional node data (from graphAlloc(),
+* or owned by the caller).
 * @return Pointer to the newly created node, or NULL on failure.
 **/
 node_t* addNode(graph_t* graph, int id, void* data);
@@ -64,7 +146,8 @@ node_t* addNode(graph_t* graph, int id, void* data);
 * @param fromId ID of the source node.
 * @param toId ID of the destination node.
 * @param weight Weight of the edge.
-* @param data Pointer to additional edge data.
+* @param data Pointer to additional edge data (from graphAlloc(),
+* or owned by the caller).
 * @return Pointer to the newly created edge, or NULL on failure.
 * The function fails if either node does not exist or if an edge already
 * exists between the two nodes.
@@ -94,6 +177,12 @@ edge_t* getEdge(graph_t* graph, int fromId, int toId);
 * @param graph Pointer to the graph.
 * @param id ID of the node to remove.
 * @return 1 if the node was removed successfully, 0 if not found.
+* The node's outgoing edges and all edges pointing to it are removed
+* too, and the nodes after it in the node array move down one index.
+* Its data is not freed (see createGraph()).
+* Nodes do not record their incoming edges, so finding them walks
+* every adjacency list: O(nodes + edges). Leaving them would keep
+* pointers to a node slot that the next addNode() may reuse.
 **/
 int removeNode(graph_t* graph, int id);
 
@@ -124,6 +213,30 @@ int removeEdge(graph_t* graph, int fromId, int toId);
 **/
 void printGraph(graph_t* graph);
 
+/**
+* Builds a read-only CSR snapshot of the graph.
+* @param graph Pointer to the graph.
+* @return Pointer to the frozen view, or NULL on failure.
+* Edges keep the order of each node's adjacency list. Later changes
+* to the graph are not reflected in the frozen view.
+**/
+csr_graph_t* freezeGraph(graph_t* graph);
+
+/**
+* Frees a frozen view created by freezeGraph().
+* The node and edge data it points to are not freed.
+* If the pointer is NULL, the function does nothing.
+**/
+void freeFrozenGraph(csr_graph_t* csr);
+
+/**
+* Fills the reverse adjacency of a CSR graph with nodeCount nodes
+* (see csr_graph_t). revOffsets needs nodeCount+1 entries, revSources
+* and revWeights one per edge. A counting sort, so O(nodes + edges).
+**/
+void csrReverse(int nodeCount, const int* offsets, const int* targets, const float* weights,
+                int* revOffsets, int* revSources, float* revWeights);
+
 #endif
 
 
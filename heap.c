@@ -0,0 +1,185 @@
+#include <string.h>
+#include "heap.h"
+
+static void swap_heap(heap_item_t *a, heap_item_t *b) {
+    heap_item_t tmp = *a; *a = *b; *b = tmp;
+}
+
+void heapPush(heap_item_t* heap, int* size, heap_item_t item) {
+    int i = (*size)++;
+    heap[i] = item;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (heap[parent].dist <= heap[i].dist) break;
+        swap_heap(&heap[parent], &heap[i]);
+        i = parent;
+    }
+}
+
+heap_item_t heapPop(heap_item_t* heap, int* size) {
+    heap_item_t result = heap[0];
+    (*size)--;
+    heap[0] = heap[*size];
+    int i = 0;
+    while (1) {
+        int l = 2*i + 1, r = 2*i + 2, smallest = i;
+        if (l < *size && heap[l].dist < heap[smallest].dist) smallest = l;
+        if (r < *size && heap[r].dist < heap[smallest].dist) smallest = r;
+        if (smallest == i) break;
+        swap_heap(&heap[i], &heap[smallest]);
+        i = smallest;
+    }
+    return result;
+}
+
+static void quad_sift_up(heap_item_t *heap, int *pos, int i) {
+    heap_item_t item = heap[i];
+    while (i > 0) {
+        int parent = (i - 1) / 4;
+        if (heap[parent].dist <= item.dist) break;
+        heap[i] = heap[parent];
+        pos[heap[i].idx] = i;
+        i = parent;
+    }
+    heap[i] = item;
+    pos[item.idx] = i;
+}
+
+void quadHeapUpdate(heap_item_t* heap, int* size, int* pos, heap_item_t item) {
+    int i = pos[item.idx];
+    if (i < 0) {
+        i = (*size)++;
+    } else if (item.dist >= heap[i].dist) {
+        return;
+    }
+    heap[i] = item;
+    quad_sift_up(heap, pos, i);
+}
+
+heap_item_t quadHeapPop(heap_item_t* heap, int* size, int* pos) {
+    heap_item_t result = heap[0];
+    pos[result.idx] = -1;
+    if (--(*size) == 0) return result;
+
+    heap_item_t item = heap[*size];
+    int i = 0;
+    while (1) {
+        int first = 4*i + 1, smallest = -1;
+        double best = item.dist;
+        for (int c = first; c < first + 4 && c < *size; ++c) {
+            if (heap[c].dist < best) { best = heap[c].dist; smallest = c; }
+        }
+        if (smallest < 0) break;
+        heap[i] = heap[smallest];
+        pos[heap[i].idx] = i;
+        i = smallest;
+    }
+    heap[i] = item;
+    pos[item.idx] = i;
+    return result;
+}
+
+static uint64_t key_bits(double key) {
+    uint64_t bits;
+    memcpy(&bits, &key, sizeof(bits));
+    return bits;
+}
+
+static double bits_key(uint64_t bits) {
+    double key;
+    memcpy(&key, &bits, sizeof(key));
+    return key;
+}
+
+static int radix_bucket(uint64_t bits, uint64_t last) {
+    return bits == last ? 0 : 64 - __builtin_clzll(bits ^ last);
+}
+
+static void radix_link(radix_heap_t *h, int v, int b) {
+    h->pos[v] = b;
+    h->prev[v] = -1;
+    h->next[v] = h->head[b];
+    if (h->head[b] >= 0) h->prev[h->head[b]] = v;
+    h->head[b] = v;
+}
+
+static void radix_unlink(radix_heap_t *h, int v) {
+    int b = h->pos[v];
+    if (h->prev[v] >= 0) h->next[h->prev[v]] = h->next[v];
+    else h->head[b] = h->next[v];
+    if (h->next[v] >= 0) h->prev[h->next[v]] = h->prev[v];
+}
+
+void radixHeapClear(radix_heap_t* h) {
+    for (int b = 0; b < RADIX_BUCKETS; ++b) {
+        for (int v = h->head[b]; v >= 0; v = h->next[v]) h->pos[v] = -1;
+        h->head[b] = -1;
+    }
+    h->size = 0;
+    h->last = 0;
+}
+
+void radixHeapUpdate(radix_heap_t* h, heap_item_t item) {
+    int v = item.idx;
+    uint64_t bits = key_bits(item.dist);
+    if (bits < h->last) bits = h->last;
+    if (h->pos[v] >= 0) {
+        if (bits >= key_bits(h->key[v])) return;
+        radix_unlink(h, v);
+    } else {
+        h->size++;
+    }
+    h->key[v] = bits_key(bits);
+    radix_link(h, v, radix_bucket(bits, h->last));
+}
+
+/*
+ * Makes bucket 0 non-empty: finds the first non-empty bucket, takes its
+ * smallest key as the new last key and spreads its nodes over the
+ * lower buckets. Nodes in higher buckets keep their bucket, as they
+ * differ from the new last key in the same highest bit as before.
+ */
+static void radix_refill(radix_heap_t *h) {
+    if (h->head[0] >= 0) return;
+    int b = 1;
+    while (h->head[b] < 0) b++;
+    uint64_t min = UINT64_MAX;
+    for (int v = h->head[b]; v >= 0; v = h->next[v]) {
+        if (key_bits(h->key[v]) < min) min = key_bits(h->key[v]);
+    }
+    h->last = min;
+    int v = h->head[b];
+    h->head[b] = -1;
+    while (v >= 0) {
+        int next = h->next[v];
+        radix_link(h, v, radix_bucket(key_bits(h->key[v]), min));
+        v = next;
+    }
+}
+
+double radixHeapTop(radix_heap_t* h) {
+    radix_refill(h);
+    return bits_key(h->last);
+}
+
+heap_item_t radixHeapPop(radix_heap_t* h) {
+    radix_refill(h);
+    int v = h->head[0];
+    radix_unlink(h, v);
+    h->pos[v] = -1;
+    h->size--;
+    return (heap_item_t){v, h->key[v]};
+}
+
+static const char *kind_names[HEAP_KIND_COUNT] = {"binary", "quad", "radix"};
+
+int heapKindFromName(const char* name) {
+    for (int i = 0; i < HEAP_KIND_COUNT; ++i) {
+        if (strcmp(name, kind_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+const char* heapKindName(heap_kind_t kind) {
+    return kind >= 0 && kind < HEAP_KIND_COUNT ? kind_names[kind] : "?";
+}
@@ -0,0 +1,113 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <stdint.h>
+
+/**
+* Entry of a min-heap keyed by dist.
+* heapPush() / heapPop() form a binary heap used with lazy deletion:
+* a node is pushed again whenever its key improves, and stale entries
+* are skipped when popped.
+**/
+typedef struct {
+    int idx;
+    double dist;
+} heap_item_t;
+
+/**
+* Priority queues the shortest path searches can run on (see
+* search_workspace_t). HEAP_BINARY is the lazy binary heap below;
+* HEAP_QUAD and HEAP_RADIX hold each node at most once and lower its
+* key in place.
+**/
+typedef enum {
+    HEAP_BINARY,
+    HEAP_QUAD,
+    HEAP_RADIX,
+    HEAP_KIND_COUNT
+} heap_kind_t;
+
+/**
+* Adds an item to a heap of *size entries. The caller guarantees room
+* for one more entry.
+**/
+void heapPush(heap_item_t* heap, int* size, heap_item_t item);
+
+/**
+* Removes and returns the item with the smallest dist.
+* The heap must not be empty.
+**/
+heap_item_t heapPop(heap_item_t* heap, int* size);
+
+/**
+* Inserts item.idx into an indexed 4-ary heap, or lowers its key if it
+* is already queued (a higher key is ignored). pos[v] is v's slot in
+* heap, or -1 while v is not queued; the caller sets it to -1 for
+* nodes it has not queued before and guarantees room for a new entry.
+**/
+void quadHeapUpdate(heap_item_t* heap, int* size, int* pos, heap_item_t item);
+
+/**
+* Removes and returns the item with the smallest dist from a 4-ary
+* heap, setting its pos to -1. The heap must not be empty.
+**/
+heap_item_t quadHeapPop(heap_item_t* heap, int* size, int* pos);
+
+#define RADIX_BUCKETS 65
+
+/**
+* Radix heap over the bit patterns of non-negative double keys (which
+* order like the values). Keys must never drop below the last popped
+* key, as in Dijkstra; a smaller key is raised to it.
+* Bucket b > 0 holds the nodes whose key first differs from the last
+* popped key in bit b-1, so each node is moved to a lower bucket at
+* most 64 times. Buckets are doubly linked lists through next/prev,
+* so the heap allocates nothing itself. Per node the caller provides
+* key, next and prev, and pos, which holds the node's bucket or -1
+* while it is not queued (set to -1 for nodes not queued before).
+**/
+typedef struct {
+    int size;
+    uint64_t last;
+    int head[RADIX_BUCKETS];
+    int* pos;
+    int* next;
+    int* prev;
+    double* key;
+} radix_heap_t;
+
+/**
+* Empties a radix heap (resetting the pos of queued nodes) and starts
+* a new sequence of keys from 0.
+**/
+void radixHeapClear(radix_heap_t* h);
+
+/**
+* Inserts item.idx, or lowers its key if it is already queued.
+**/
+void radixHeapUpdate(radix_heap_t* h, heap_item_t item);
+
+/**
+* Smallest key in a non-empty radix heap. May move nodes between
+* buckets, but never changes what is queued.
+**/
+double radixHeapTop(radix_heap_t* h);
+
+/**
+* Removes and returns a node with the smallest key, setting its pos to
+* -1. The heap must not be empty.
+**/
+heap_item_t radixHeapPop(radix_heap_t* h);
+
+/**
+* Looks up a heap kind by name ("binary", "quad", "radix").
+* @return The kind, or -1 if the name is unknown.
+**/
+int heapKindFromName(const char* name);
+
+/**
+* Name of a heap kind, as accepted by heapKindFromName().
+**/
+const char* heapKindName(heap_kind_t kind);
+
+#endif
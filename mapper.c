@@ -1,8 +1,26 @@
 #include <stdio.h>
+#include <string.h>
 #include "data.h"
 
-int main() {
-    int result = validate();
+int main(int argc, char **argv) {
+    int stream = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-engine") == 0 && i + 1 < argc &&
+            (strcmp(argv[i+1], "scanf") == 0 || strcmp(argv[i+1], "stream") == 0)) {
+            stream = strcmp(argv[++i], "stream") == 0;
+        } else {
+            fprintf(stderr, "Usage: %s [-engine scanf|stream] < file\n", argv[0]);
+            return 1;
+        }
+    }
+
+    int result = stream ? validateStream(stdin) : validate();
+
+    if (result < 0) {
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
 
     if (result == 0) {
         printf("VALID\n");
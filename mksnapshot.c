@@ -0,0 +1,42 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "city.h"
+
+int main(int argc, char **argv) {
+    int hierarchy = argc == 4 && strcmp(argv[1], "-ch") == 0;
+    if (argc != 3 && !hierarchy) {
+        printf("Usage: %s [-ch] <input.tsv> <output.snap>\n", argv[0]);
+        printf("Converts a tab-separated city data file into a binary snapshot\n");
+        printf("that citydata -f can map directly. -ch also stores a contraction\n");
+        printf("hierarchy for citydata -router ch.\n");
+        return 1;
+    }
+    const char *input = argv[argc - 2], *output = argv[argc - 1];
+
+    city_t *c = loadCity(input);
+    if (!c) {
+        fprintf(stderr, "Error: failed to load graph from '%s'\n", input);
+        return 1;
+    }
+
+    if (hierarchy && !cityAddHierarchy(c)) {
+        fprintf(stderr, "Error: could not build contraction hierarchy\n");
+        freeCity(c);
+        return 1;
+    }
+
+    if (!writeCitySnapshot(c, output)) {
+        fprintf(stderr, "Error: could not write snapshot '%s'\n", output);
+        freeCity(c);
+        return 1;
+    }
+
+    printf("%d nodes, %d edges, %u bytes of names -> %s (%zu bytes)\n",
+           c->net.nodeCount, c->net.edgeCount, c->stringsSize, output, c->imageSize);
+    if (c->ch.nodeCount)
+        printf("hierarchy: %d shortcuts, %d upward and %d downward edges\n",
+               c->ch.shortcuts, c->ch.upCount, c->ch.downCount);
+    freeCity(c);
+    return 0;
+}
@@ -0,0 +1,411 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include "route.h"
+#include "ch.h"
+#include "geo.h"
+#include "heap.h"
+#include "workspace.h"
+#include "workers.h"
+
+static const char *algo_names[ROUTE_ALGO_COUNT] = {"dijkstra", "astar", "bidir", "ch"};
+
+/*
+ * Dijkstra and A* share one loop: the heap is keyed by dist + estimate,
+ * where the estimate is 0 for Dijkstra. The A* estimate is consistent
+ * (see heuristicScale in city.h), so a settled node is final and the
+ * search can stop when the target is popped, exactly as Dijkstra does.
+ * Estimates are cached per node since haversine() is not cheap.
+ * Only nodes the search reaches are touched, so a query near the
+ * source costs little however large the graph is.
+ */
+static double search(search_workspace_t *ws, const city_t *c, const float *factor, int sIndex, int tIndex,
+                     int useEstimate, int *settled) {
+    const csr_graph_t *g = &c->net;
+    const city_poi_t *target = &c->pois[tIndex];
+    double scale = useEstimate ? c->heuristicScale : 0.0;
+    double *dist = ws->dist[0], *estimate = ws->estimate;
+    unsigned int *reached = ws->reached[0], *done = ws->settled[0], epoch = ws->epoch;
+    int count = 0, ok = workspacePush(ws, 0, sIndex, 0.0, 0.0);
+
+    while (ok && workspaceQueued(ws, 0) > 0) {
+        int u = workspacePop(ws, 0).idx;
+        if (done[u] == epoch) continue;
+        done[u] = epoch;
+        count++;
+        if (u == tIndex) break;
+
+        for (int k = g->offsets[u]; k < g->offsets[u + 1] && ok; ++k) {
+            int vIndex = g->targets[k];
+            if (done[vIndex] == epoch) continue;
+            double alt = dist[u] + (factor ? (double) g->weights[k] * factor[k] : (double) g->weights[k]);
+            if (reached[vIndex] == epoch ? alt < dist[vIndex] : alt < INFINITY) {
+                if (reached[vIndex] != epoch) {
+                    const city_poi_t *p = &c->pois[vIndex];
+                    estimate[vIndex] = scale > 0.0 ? scale * haversine(p->lat, p->lon, target->lat, target->lon) : 0.0;
+                }
+                ok = workspacePush(ws, 0, vIndex, alt, alt + estimate[vIndex]);
+            }
+        }
+    }
+
+    if (settled) *settled = count;
+    return ok ? workspaceDist(ws, 0, tIndex) : INFINITY;
+}
+
+/*
+ * Bidirectional Dijkstra: a forward search from sIndex over the CSR
+ * edges and a backward search from tIndex over the reverse adjacency,
+ * always advancing the side whose heap top is smaller. best is the
+ * shortest s-t path seen through any edge relaxed by either side. Once
+ * the two heap tops add up to at least best, no unsettled node can lie
+ * on a shorter path, so best is the answer. A stale (lazily deleted)
+ * heap top is never above the true minimum, so it only delays the stop.
+ * With an overlay, the backward side finds each reverse entry's factor
+ * through reverseEdge.
+ */
+static double bidirectional(search_workspace_t *ws, const city_t *c, const route_overlay_t *overlay, int sIndex,
+                            int tIndex, int *settled) {
+    const csr_graph_t *g = &c->net;
+    const int *offsets[2] = {g->offsets, g->revOffsets};
+    const int *ends[2] = {g->targets, g->revSources};
+    const float *weights[2] = {g->weights, g->revWeights};
+    unsigned int epoch = ws->epoch;
+    int count = 0;
+    int ok = workspacePush(ws, 0, sIndex, 0.0, 0.0) && workspacePush(ws, 1, tIndex, 0.0, 0.0);
+    double best = sIndex == tIndex ? 0.0 : INFINITY;
+
+    while (ok && workspaceQueued(ws, 0) > 0 && workspaceQueued(ws, 1) > 0) {
+        if (workspaceTop(ws, 0) + workspaceTop(ws, 1) >= best) break;
+        int d = workspaceTop(ws, 0) <= workspaceTop(ws, 1) ? 0 : 1;
+        int u = workspacePop(ws, d).idx;
+        if (ws->settled[d][u] == epoch) continue;
+        ws->settled[d][u] = epoch;
+        count++;
+
+        for (int k = offsets[d][u]; k < offsets[d][u + 1] && ok; ++k) {
+            int v = ends[d][k];
+            if (ws->settled[d][v] == epoch) continue;
+            double w = weights[d][k];
+            if (overlay) w *= overlay->factor[d == 0 ? k : overlay->reverseEdge[k]];
+            double alt = ws->dist[d][u] + w;
+            if (alt < workspaceDist(ws, d, v)) {
+                ok = workspacePush(ws, d, v, alt, alt);
+                if (alt + workspaceDist(ws, 1 - d, v) < best) best = alt + workspaceDist(ws, 1 - d, v);
+            }
+        }
+    }
+
+    if (settled) *settled = count;
+    return ok ? best : INFINITY;
+}
+
+double routeQuery(search_workspace_t* ws, const city_t* city, route_algo_t algo, int sIndex, int tIndex, int* settled) {
+    return routeQueryOverlay(ws, city, algo, NULL, sIndex, tIndex, settled);
+}
+
+double routeQueryOverlay(search_workspace_t* ws, const city_t* city, route_algo_t algo, const route_overlay_t* overlay,
+                         int sIndex, int tIndex, int* settled) {
+    if (settled) *settled = 0;
+    if (!ws || !city || sIndex < 0 || tIndex < 0) return INFINITY;
+    if (!workspaceReset(ws, city->net.nodeCount)) return INFINITY;
+    if (overlay && overlay->changedCount == 0) overlay = NULL;
+    if (algo == ROUTE_CH && !overlay) return hierarchyDistance(city, ws, sIndex, tIndex, settled);
+    if (algo == ROUTE_CH || algo == ROUTE_BIDIRECTIONAL) return bidirectional(ws, city, overlay, sIndex, tIndex, settled);
+    return search(ws, city, overlay ? overlay->factor : NULL, sIndex, tIndex, algo == ROUTE_ASTAR, settled);
+}
+
+route_overlay_t* createRouteOverlay(const city_t* city) {
+    const csr_graph_t *g = &city->net;
+    int n = g->nodeCount, m = g->edgeCount;
+    route_overlay_t *overlay = calloc(1, sizeof(route_overlay_t));
+    if (!overlay) return NULL;
+    overlay->edgeCount = m;
+    overlay->factor = malloc(sizeof(float) * (m + 1));
+    overlay->reverseEdge = malloc(sizeof(int) * (m + 1));
+    overlay->changed = malloc(sizeof(int) * (m + 1));
+    overlay->slot = malloc(sizeof(int) * (m + 1));
+    int *cursor = malloc(sizeof(int) * (n + 1));
+    if (!overlay->factor || !overlay->reverseEdge || !overlay->changed || !overlay->slot || !cursor) {
+        free(cursor);
+        freeRouteOverlay(overlay);
+        return NULL;
+    }
+    for (int k = 0; k < m; ++k) {
+        overlay->factor[k] = 1.0f;
+        overlay->slot[k] = -1;
+    }
+
+    // Reverse entries into v are ordered by tail, as are the edges
+    // visited here, so each lands in the next free slot of its head.
+    memcpy(cursor, g->revOffsets, sizeof(int) * n);
+    for (int u = 0; u < n; ++u) {
+        for (int k = g->offsets[u]; k < g->offsets[u + 1]; ++k) overlay->reverseEdge[cursor[g->targets[k]]++] = k;
+    }
+    free(cursor);
+    return overlay;
+}
+
+void freeRouteOverlay(route_overlay_t* overlay) {
+    if (!overlay) return;
+    free(overlay->factor);
+    free(overlay->reverseEdge);
+    free(overlay->changed);
+    free(overlay->slot);
+    free(overlay);
+}
+
+void routeOverlaySet(route_overlay_t* overlay, int edge, float factor) {
+    if (!(factor >= 1.0f)) factor = 1.0f;
+    overlay->factor[edge] = factor;
+    int at = overlay->slot[edge];
+    if (factor != 1.0f && at < 0) {
+        overlay->slot[edge] = overlay->changedCount;
+        overlay->changed[overlay->changedCount++] = edge;
+    } else if (factor == 1.0f && at >= 0) {
+        // Swap-remove, so changedCount is the edges off 1 right now.
+        int last = overlay->changed[--overlay->changedCount];
+        overlay->changed[at] = last;
+        overlay->slot[last] = at;
+        overlay->slot[edge] = -1;
+    }
+}
+
+void routeOverlayClear(route_overlay_t* overlay) {
+    for (int i = 0; i < overlay->changedCount; ++i) {
+        int k = overlay->changed[i];
+        overlay->factor[k] = 1.0f;
+        overlay->slot[k] = -1;
+    }
+    overlay->changedCount = 0;
+}
+
+double routeDistance(const city_t* city, route_algo_t algo, int sIndex, int tIndex, int* settled) {
+    if (settled) *settled = 0;
+    search_workspace_t *ws = createWorkspace();
+    double result = routeQuery(ws, city, algo, sIndex, tIndex, settled);
+    freeWorkspace(ws);
+    return result;
+}
+
+/*
+ * Dijkstra from s that stops once remaining of the nodes flagged in
+ * wanted are settled, or runs to exhaustion when wanted is NULL.
+ * Afterwards ws->settled[0] marks the settled nodes, whose dist[0] is
+ * final. Returns 0 if the heap could not grow.
+ */
+static int settle_from(const csr_graph_t *g, int s, const unsigned char *wanted, int remaining, search_workspace_t *ws) {
+    if (!workspaceReset(ws, g->nodeCount) || !workspacePush(ws, 0, s, 0.0, 0.0)) return 0;
+    double *dist = ws->dist[0];
+    unsigned int *reached = ws->reached[0], *done = ws->settled[0], epoch = ws->epoch;
+    while (workspaceQueued(ws, 0) > 0 && (!wanted || remaining > 0)) {
+        int u = workspacePop(ws, 0).idx;
+        if (done[u] == epoch) continue;
+        done[u] = epoch;
+        if (wanted && wanted[u]) remaining--;
+        for (int k = g->offsets[u]; k < g->offsets[u + 1]; ++k) {
+            int v = g->targets[k];
+            if (done[v] == epoch) continue;
+            double alt = dist[u] + (double) g->weights[k];
+            if (reached[v] == epoch ? alt < dist[v] : alt < INFINITY) {
+                if (!workspacePush(ws, 0, v, alt, alt)) return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/*
+ * Dijkstra bounded by limit: relaxations that would pass it are not
+ * queued, so every popped node is inside and the search ends when the
+ * region is exhausted. Nodes are appended as they are settled, which
+ * is nearest first; the output arrays double as they fill.
+ */
+int routeIsochrone(search_workspace_t* ws, const city_t* city, const route_overlay_t* overlay, int sIndex,
+                   double limit, int** nodes, double** dists) {
+    *nodes = NULL;
+    if (dists) *dists = NULL;
+    if (!ws || !city || sIndex < 0 || sIndex >= city->net.nodeCount || !(limit >= 0.0)) return 0;
+    if (!workspaceReset(ws, city->net.nodeCount) || !workspacePush(ws, 0, sIndex, 0.0, 0.0)) return -1;
+
+    const csr_graph_t *g = &city->net;
+    const float *factor = overlay && overlay->changedCount > 0 ? overlay->factor : NULL;
+    double *dist = ws->dist[0];
+    unsigned int *done = ws->settled[0], epoch = ws->epoch;
+    int count = 0, space = 0, ok = 1;
+
+    while (ok && workspaceQueued(ws, 0) > 0) {
+        int u = workspacePop(ws, 0).idx;
+        if (done[u] == epoch) continue;
+        done[u] = epoch;
+        if (count == space) {
+            space = space ? space * 2 : 64;
+            int *grownNodes = realloc(*nodes, sizeof(int) * space);
+            if (grownNodes) *nodes = grownNodes;
+            double *grownDists = dists ? realloc(*dists, sizeof(double) * space) : NULL;
+            if (grownDists) *dists = grownDists;
+            if (!grownNodes || (dists && !grownDists)) { ok = 0; break; }
+        }
+        (*nodes)[count] = u;
+        if (dists) (*dists)[count] = dist[u];
+        count++;
+
+        for (int k = g->offsets[u]; k < g->offsets[u + 1] && ok; ++k) {
+            int v = g->targets[k];
+            if (done[v] == epoch) continue;
+            double alt = dist[u] + (factor ? (double) g->weights[k] * factor[k] : (double) g->weights[k]);
+            if (alt <= limit && alt < workspaceDist(ws, 0, v)) ok = workspacePush(ws, 0, v, alt, alt);
+        }
+    }
+
+    if (!ok) {
+        free(*nodes);
+        *nodes = NULL;
+        if (dists) { free(*dists); *dists = NULL; }
+        return -1;
+    }
+    return count;
+}
+
+/*
+ * Creates a worker's workspace on the caller's queue kind, sized up
+ * front so that a later allocation failure can only come from heap
+ * growth.
+ */
+static search_workspace_t* worker_workspace(const csr_graph_t *g, heap_kind_t heap) {
+    search_workspace_t *ws = createWorkspace();
+    if (ws) ws->heapKind = heap;
+    if (ws && !workspaceReset(ws, g->nodeCount)) { freeWorkspace(ws); ws = NULL; }
+    return ws;
+}
+
+typedef struct {
+    const city_t *city;
+    const int *sources, *targets;
+    int sourceCount, targetCount;
+    const unsigned char *wanted; // 1 for nodes that are some column's target
+    int wantedCount;             // distinct targets
+    heap_kind_t heap;
+    double *out;
+    atomic_int next;
+    atomic_int failed;           // a claimed row could not be computed
+} matrix_job_t;
+
+static void* matrix_worker(void *arg) {
+    matrix_job_t *job = arg;
+    search_workspace_t *ws = worker_workspace(&job->city->net, job->heap);
+    if (!ws) return NULL;
+
+    int row;
+    while ((row = atomic_fetch_add(&job->next, 1)) < job->sourceCount) {
+        double *out = job->out + (size_t) row * job->targetCount;
+        int s = job->sources[row];
+        if (s < 0) {
+            for (int j = 0; j < job->targetCount; ++j) out[j] = INFINITY;
+            continue;
+        }
+        if (!settle_from(&job->city->net, s, job->wanted, job->wantedCount, ws)) {
+            atomic_store(&job->failed, 1);
+            break;
+        }
+        // Settled targets hold final distances; the rest are unreachable.
+        for (int j = 0; j < job->targetCount; ++j) {
+            int t = job->targets[j];
+            out[j] = t >= 0 && ws->settled[0][t] == ws->epoch ? ws->dist[0][t] : INFINITY;
+        }
+    }
+
+    freeWorkspace(ws);
+    return NULL;
+}
+
+int routeMatrix(const city_t* city, const int* sources, int sourceCount,
+                const int* targets, int targetCount, heap_kind_t heap, int threads, double* out) {
+    if (!city || sourceCount <= 0 || targetCount <= 0) return 1;
+    int n = city->net.nodeCount;
+    unsigned char *wanted = calloc(n > 0 ? n : 1, 1);
+    if (!wanted) return 0;
+
+    matrix_job_t job = {city, sources, targets, sourceCount, targetCount, wanted, 0, heap, out};
+    for (int j = 0; j < targetCount; ++j) {
+        if (targets[j] >= 0 && !wanted[targets[j]]) { wanted[targets[j]] = 1; job.wantedCount++; }
+    }
+    atomic_init(&job.next, 0);
+    atomic_init(&job.failed, 0);
+    runWorkers(matrix_worker, &job, threads < sourceCount ? threads : sourceCount);
+
+    // A worker that could not start leaves its rows to the others, so
+    // the matrix is only incomplete if every worker failed.
+    free(wanted);
+    return atomic_load(&job.next) >= sourceCount && !atomic_load(&job.failed);
+}
+
+typedef struct {
+    const city_t *city;
+    heap_kind_t heap;
+    double *ecc;
+    int *far;
+    atomic_int next;
+    atomic_int failed;
+} diameter_job_t;
+
+static void* diameter_worker(void *arg) {
+    diameter_job_t *job = arg;
+    const csr_graph_t *g = &job->city->net;
+    search_workspace_t *ws = worker_workspace(g, job->heap);
+    if (!ws) return NULL;
+
+    int s;
+    while ((s = atomic_fetch_add(&job->next, 1)) < g->nodeCount) {
+        if (!settle_from(g, s, NULL, 0, ws)) {
+            atomic_store(&job->failed, 1);
+            break;
+        }
+        double best = 0.0;
+        int far = -1;
+        for (int v = 0; v < g->nodeCount; ++v) {
+            if (ws->settled[0][v] == ws->epoch && v != s && (far < 0 || ws->dist[0][v] > best)) { best = ws->dist[0][v]; far = v; }
+        }
+        job->ecc[s] = best;
+        job->far[s] = far;
+    }
+
+    freeWorkspace(ws);
+    return NULL;
+}
+
+double routeDiameter(const city_t* city, heap_kind_t heap, int threads, double* ecc, int* a, int* b) {
+    *a = *b = -1;
+    int n = city ? city->net.nodeCount : 0;
+    if (n < 2) return -1.0;
+    diameter_job_t job = {city, heap, ecc ? ecc : malloc(sizeof(double) * n), malloc(sizeof(int) * n)};
+    if (!job.ecc || !job.far) {
+        if (!ecc) free(job.ecc);
+        free(job.far);
+        return NAN;
+    }
+    atomic_init(&job.next, 0);
+    atomic_init(&job.failed, 0);
+    runWorkers(diameter_worker, &job, threads < n ? threads : n);
+
+    // Reduce in node order so the pair does not depend on scheduling.
+    double best = atomic_load(&job.next) >= n && !atomic_load(&job.failed) ? -1.0 : NAN;
+    for (int s = 0; s < n && !isnan(best); ++s) {
+        if (job.far[s] >= 0 && job.ecc[s] > best) { best = job.ecc[s]; *a = s; *b = job.far[s]; }
+    }
+    if (!ecc) free(job.ecc);
+    free(job.far);
+    return best;
+}
+
+int routeAlgoFromName(const char* name) {
+    for (int i = 0; i < ROUTE_ALGO_COUNT; ++i) {
+        if (strcmp(name, algo_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+const char* routeAlgoName(route_algo_t algo) {
+    return algo >= 0 && algo < ROUTE_ALGO_COUNT ? algo_names[algo] : "?";
+}
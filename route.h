@@ -0,0 +1,146 @@
+#ifndef ROUTE_H
+#define ROUTE_H
+
+#include "city.h"
+#include "workspace.h"
+
+/**
+* Point-to-point shortest path algorithms over a city's road network.
+* ROUTE_DIJKSTRA is plain Dijkstra; ROUTE_ASTAR is A* with
+* city->heuristicScale * haversine() to the target as the heuristic;
+* ROUTE_BIDIRECTIONAL searches forward from the source and backward
+* from the target (over net's reverse adjacency) until they meet;
+* ROUTE_CH runs the upward searches of the city's contraction
+* hierarchy (see cityAddHierarchy()), which it must have.
+* All return the same distances (ROUTE_CH up to summation order).
+**/
+typedef enum {
+    ROUTE_DIJKSTRA,
+    ROUTE_ASTAR,
+    ROUTE_BIDIRECTIONAL,
+    ROUTE_CH,
+    ROUTE_ALGO_COUNT
+} route_algo_t;
+
+/**
+* Shortest road distance from node sIndex to node tIndex, using ws for
+* all scratch memory. Reusing one workspace across queries makes each
+* query cost time in proportion to the part of the graph it explores.
+* @param settled If not NULL, receives the number of nodes settled.
+* @return The distance in meters, or INFINITY if tIndex is unreachable
+* or memory allocation fails.
+**/
+double routeQuery(search_workspace_t* ws, const city_t* city, route_algo_t algo, int sIndex, int tIndex, int* settled);
+
+/**
+* Changes to road weights laid over a city for routing, without
+* touching the city: with the overlay, edge k (in net's CSR order)
+* costs weights[k] * factor[k]. A factor of 1 leaves the road as it is,
+* a larger one penalises it and INFINITY closes it; factors below 1
+* are not allowed, so the A* heuristic stays admissible.
+* reverseEdge maps each entry of net's reverse adjacency to its
+* forward edge, for the backward side of ROUTE_BIDIRECTIONAL.
+* changed lists, once each, the edges whose factor is not 1 right now
+* (slot[k] is edge k's position in it, -1 if it is not listed): an
+* edge set back to 1 leaves the list, so changedCount is 0 again once
+* every road has reopened. Updates cost O(1) and clearing the number of
+* edges changed, not the size of the network.
+**/
+typedef struct {
+    int edgeCount;
+    float* factor;
+    int* reverseEdge;
+    int* changed;
+    int changedCount;
+    int* slot;
+} route_overlay_t;
+
+/**
+* Creates an overlay for the city with every factor 1. O(nodes + edges).
+* @return Pointer to the overlay, or NULL if memory allocation fails.
+**/
+route_overlay_t* createRouteOverlay(const city_t* city);
+
+/**
+* Frees an overlay. If the pointer is NULL, the function does nothing.
+**/
+void freeRouteOverlay(route_overlay_t* overlay);
+
+/**
+* Sets the factor of one edge (values below 1 count as 1). O(1).
+**/
+void routeOverlaySet(route_overlay_t* overlay, int edge, float factor);
+
+/**
+* Sets every changed factor back to 1. O(edges changed).
+**/
+void routeOverlayClear(route_overlay_t* overlay);
+
+/**
+* routeQuery() with the weights of overlay (NULL for none) applied as
+* each edge is relaxed. The city is not modified. ROUTE_CH runs as
+* ROUTE_BIDIRECTIONAL while any factor is not 1 (changedCount > 0),
+* since the hierarchy's shortcuts are built from the unmodified weights.
+**/
+double routeQueryOverlay(search_workspace_t* ws, const city_t* city, route_algo_t algo, const route_overlay_t* overlay,
+                         int sIndex, int tIndex, int* settled);
+
+/**
+* routeQuery() with a workspace of its own, created and freed per call
+* (so O(nodeCount) setup each time). Convenient for one-off queries.
+**/
+double routeDistance(const city_t* city, route_algo_t algo, int sIndex, int tIndex, int* settled);
+
+/**
+* Shortest road distances from every source to every target, written
+* row-major to out (sourceCount x targetCount). Each source runs one
+* Dijkstra search that stops once all targets are settled, so a row
+* costs about one search rather than targetCount of them. Sources are
+* handed out to up to threads worker threads (fewer than 1 means 1),
+* each searching with a workspace on the heap queue kind.
+* Negative indices (unknown names) give rows or columns of INFINITY,
+* as do unreachable targets.
+* @return 1 on success, 0 if memory or a thread could not be obtained.
+**/
+int routeMatrix(const city_t* city, const int* sources, int sourceCount,
+                const int* targets, int targetCount, heap_kind_t heap, int threads, double* out);
+
+/**
+* Every node within limit meters of road distance from sIndex (an
+* isochrone), with the weights of overlay (NULL for none). A Dijkstra
+* search in ws that never queues a node beyond limit and stops once
+* the heap is empty, so it costs the region inside the limit however
+* large the network is, and repeated calls reuse the workspace.
+* @param nodes, dists Receive malloc'd arrays of the nodes reached,
+* nearest first (sIndex first, at 0), and their distances (dists may
+* be NULL), which the caller frees; set to NULL when none are reached.
+* @return Number of nodes reached, or -1 if memory allocation fails.
+**/
+int routeIsochrone(search_workspace_t* ws, const city_t* city, const route_overlay_t* overlay, int sIndex,
+                   double limit, int** nodes, double** dists);
+
+/**
+* Road-network diameter: the longest shortest road distance between
+* two nodes, ignoring pairs with no route. Runs one full Dijkstra
+* search per node; nodes are handed out to up to threads worker
+* threads, each with its own workspace on the heap queue kind.
+* @param ecc If not NULL, receives every node's eccentricity (nodeCount
+* entries): the farthest distance it reaches, 0 if it reaches nothing.
+* @param a, b Receive the pair; ties go to the lowest a, then lowest b.
+* @return The distance in meters, -1 if no node reaches another, or
+* NAN if memory could not be obtained.
+**/
+double routeDiameter(const city_t* city, heap_kind_t heap, int threads, double* ecc, int* a, int* b);
+
+/**
+* Looks up an algorithm by name ("dijkstra", "astar", "bidir", "ch").
+* @return The algorithm, or -1 if the name is unknown.
+**/
+int routeAlgoFromName(const char* name);
+
+/**
+* Name of an algorithm, as accepted by routeAlgoFromName().
+**/
+const char* routeAlgoName(route_algo_t algo);
+
+#endif
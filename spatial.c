@@ -0,0 +1,226 @@
+#include <stdlib.h>
+#include <math.h>
+#include "spatial.h"
+#include "geo.h"
+
+// Total order along one axis, so the build does not depend on qsort.
+static int before(const city_spatial_point_t *a, const city_spatial_point_t *b, int axis) {
+    if (a->xyz[axis] != b->xyz[axis]) return a->xyz[axis] < b->xyz[axis];
+    return a->node < b->node;
+}
+
+static void swap_points(city_spatial_point_t *a, city_spatial_point_t *b) {
+    city_spatial_point_t tmp = *a; *a = *b; *b = tmp;
+}
+
+// Quickselect: puts the k-th smallest of p[lo, hi) at k along axis.
+static void select_kth(city_spatial_point_t *p, int lo, int hi, int k, int axis) {
+    while (hi - lo > 1) {
+        swap_points(&p[lo + (hi - lo) / 2], &p[hi - 1]);
+        int store = lo;
+        for (int i = lo; i < hi - 1; ++i) {
+            if (before(&p[i], &p[hi - 1], axis)) swap_points(&p[i], &p[store++]);
+        }
+        swap_points(&p[store], &p[hi - 1]);
+        if (store == k) return;
+        if (k < store) hi = store;
+        else lo = store + 1;
+    }
+}
+
+static void build(city_spatial_point_t *p, int lo, int hi) {
+    if (hi - lo < 1) return;
+    double min[3], max[3];
+    for (int a = 0; a < 3; ++a) min[a] = max[a] = p[lo].xyz[a];
+    for (int i = lo + 1; i < hi; ++i) {
+        for (int a = 0; a < 3; ++a) {
+            if (p[i].xyz[a] < min[a]) min[a] = p[i].xyz[a];
+            if (p[i].xyz[a] > max[a]) max[a] = p[i].xyz[a];
+        }
+    }
+    int axis = 0;
+    for (int a = 1; a < 3; ++a) {
+        if (max[a] - min[a] > max[axis] - min[axis]) axis = a;
+    }
+    int mid = lo + (hi - lo) / 2;
+    select_kth(p, lo, hi, mid, axis);
+    p[mid].axis = axis;
+    build(p, lo, mid);
+    build(p, mid + 1, hi);
+}
+
+int spatialBuild(const city_poi_t* pois, int n, city_spatial_point_t* out) {
+    int count = 0;
+    for (int i = 0; i < n; ++i) {
+        if (!isfinite(pois[i].lat) || !isfinite(pois[i].lon)) continue;
+        geoUnitVector(pois[i].lat, pois[i].lon, out[count].xyz);
+        out[count].node = i;
+        out[count].axis = 0;
+        count++;
+    }
+    build(out, 0, count);
+    return count;
+}
+
+/*
+ * The chord between two unit vectors is at least their separation
+ * along any axis, and haversine() grows with the chord, so this is a
+ * lower bound on the distance to anything beyond a splitting plane.
+ * It is shaved slightly so rounding never prunes a true candidate.
+ */
+static double plane_bound(double gap) {
+    double half = fabs(gap) / 2.0;
+    if (half > 1.0) half = 1.0;
+    return 2.0 * EARTH_RADIUS_M * asin(half) * (1.0 - 1e-9) - 1e-6;
+}
+
+typedef struct {
+    const city_t *city;
+    double lat, lon;
+    double q[3];
+    int k, count;
+    int *nodes;       // max-heap of the best count results, worst on top
+    double *dists;
+} nearest_t;
+
+static int worse(const nearest_t *s, int i, int j) {
+    if (s->dists[i] != s->dists[j]) return s->dists[i] > s->dists[j];
+    return s->nodes[i] > s->nodes[j];
+}
+
+static void swap_result(nearest_t *s, int i, int j) {
+    int node = s->nodes[i]; s->nodes[i] = s->nodes[j]; s->nodes[j] = node;
+    double d = s->dists[i]; s->dists[i] = s->dists[j]; s->dists[j] = d;
+}
+
+static void sift_down(nearest_t *s, int i, int size) {
+    while (1) {
+        int l = 2*i + 1, r = 2*i + 2, top = i;
+        if (l < size && worse(s, l, top)) top = l;
+        if (r < size && worse(s, r, top)) top = r;
+        if (top == i) return;
+        swap_result(s, i, top);
+        i = top;
+    }
+}
+
+static void offer(nearest_t *s, int node, double d) {
+    if (s->count < s->k) {
+        int i = s->count++;
+        s->nodes[i] = node;
+        s->dists[i] = d;
+        while (i > 0 && worse(s, i, (i - 1) / 2)) {
+            swap_result(s, i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
+    } else if (d < s->dists[0] || (d == s->dists[0] && node < s->nodes[0])) {
+        s->nodes[0] = node;
+        s->dists[0] = d;
+        sift_down(s, 0, s->count);
+    }
+}
+
+static void nearest(nearest_t *s, int lo, int hi) {
+    if (hi <= lo) return;
+    int mid = lo + (hi - lo) / 2;
+    const city_spatial_point_t *p = &s->city->spatial[mid];
+    const city_poi_t *poi = &s->city->pois[p->node];
+    offer(s, p->node, haversine(s->lat, s->lon, poi->lat, poi->lon));
+
+    double gap = s->q[p->axis] - p->xyz[p->axis];
+    int nearLo = gap < 0.0 ? lo : mid + 1, nearHi = gap < 0.0 ? mid : hi;
+    nearest(s, nearLo, nearHi);
+    if (s->count < s->k || plane_bound(gap) <= s->dists[0]) {
+        nearest(s, gap < 0.0 ? mid + 1 : lo, gap < 0.0 ? hi : mid);
+    }
+}
+
+int spatialNearest(const city_t* city, double lat, double lon, int k, int* nodes, double* dists) {
+    if (!city || k <= 0 || city->spatialCount == 0) return 0;
+    nearest_t s = {city, lat, lon, {0.0, 0.0, 0.0}, k, 0, nodes, dists};
+    double *own = NULL;
+    if (!dists) {
+        own = malloc(sizeof(double) * k);
+        if (!own) return 0;
+        s.dists = own;
+    }
+    geoUnitVector(lat, lon, s.q);
+    nearest(&s, 0, (int) city->spatialCount);
+
+    // Heap sort: repeatedly move the worst remaining result to the end.
+    for (int size = s.count; size > 1; --size) {
+        swap_result(&s, 0, size - 1);
+        sift_down(&s, 0, size - 1);
+    }
+    free(own);
+    return s.count;
+}
+
+typedef struct {
+    double dist;
+    int node;
+} hit_t;
+
+typedef struct {
+    const city_t *city;
+    double lat, lon, radius;
+    double q[3];
+    int count, space;
+    hit_t *hits;
+} within_t;
+
+static int within(within_t *s, int lo, int hi) {
+    if (hi <= lo) return 1;
+    int mid = lo + (hi - lo) / 2;
+    const city_spatial_point_t *p = &s->city->spatial[mid];
+    const city_poi_t *poi = &s->city->pois[p->node];
+    double d = haversine(s->lat, s->lon, poi->lat, poi->lon);
+    if (d <= s->radius) {
+        if (s->count == s->space) {
+            int space = s->space ? s->space * 2 : 16;
+            hit_t *grown = realloc(s->hits, sizeof(hit_t) * space);
+            if (!grown) return 0;
+            s->hits = grown;
+            s->space = space;
+        }
+        s->hits[s->count++] = (hit_t){d, p->node};
+    }
+
+    double gap = s->q[p->axis] - p->xyz[p->axis];
+    int lower = gap < 0.0 || plane_bound(gap) <= s->radius;
+    int upper = gap >= 0.0 || plane_bound(gap) <= s->radius;
+    return (!lower || within(s, lo, mid)) && (!upper || within(s, mid + 1, hi));
+}
+
+static int cmp_hit(const void *a, const void *b) {
+    const hit_t *x = a, *y = b;
+    if (x->dist != y->dist) return x->dist < y->dist ? -1 : 1;
+    return x->node - y->node;
+}
+
+int spatialWithin(const city_t* city, double lat, double lon, double radius, int** nodes, double** dists) {
+    *nodes = NULL;
+    if (dists) *dists = NULL;
+    if (!city || !(radius >= 0.0) || city->spatialCount == 0) return 0;
+
+    within_t s = {city, lat, lon, radius, {0.0, 0.0, 0.0}, 0, 0, NULL};
+    geoUnitVector(lat, lon, s.q);
+    if (!within(&s, 0, (int) city->spatialCount)) { free(s.hits); return -1; }
+    if (s.count == 0) { free(s.hits); return 0; }
+    qsort(s.hits, s.count, sizeof(hit_t), cmp_hit);
+
+    *nodes = malloc(sizeof(int) * s.count);
+    if (dists) *dists = malloc(sizeof(double) * s.count);
+    if (!*nodes || (dists && !*dists)) {
+        free(*nodes); *nodes = NULL;
+        if (dists) { free(*dists); *dists = NULL; }
+        free(s.hits);
+        return -1;
+    }
+    for (int i = 0; i < s.count; ++i) {
+        (*nodes)[i] = s.hits[i].node;
+        if (dists) (*dists)[i] = s.hits[i].dist;
+    }
+    free(s.hits);
+    return s.count;
+}
@@ -0,0 +1,36 @@
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include "city.h"
+
+/**
+* Builds the k-d tree of a city's spatial index from its POI records.
+* POIs whose latitude or longitude is not finite are left out.
+* Subtrees split at the median along the axis of widest spread; ties
+* are ordered by node, so the same POIs always give the same tree.
+* @param out Receives one point per POI with finite coordinates.
+* @return The number of points written.
+**/
+int spatialBuild(const city_poi_t* pois, int n, city_spatial_point_t* out);
+
+/**
+* Finds the k POIs closest to (lat, lon) by haversine(), using the
+* city's spatial index. Results are ordered by distance, ties by node
+* index, and are exactly those a scan of every POI would return.
+* @param nodes Receives up to k node indices.
+* @param dists If not NULL, receives their distances in meters.
+* @return Number of results (less than k only if the city has fewer
+* POIs with coordinates).
+**/
+int spatialNearest(const city_t* city, double lat, double lon, int k, int* nodes, double* dists);
+
+/**
+* Finds every POI within radius meters of (lat, lon) by haversine(),
+* ordered like spatialNearest().
+* @param nodes, dists Receive malloc'd arrays of the results (dists
+* may be NULL), which the caller frees; set to NULL when none match.
+* @return Number of results, or -1 if memory allocation fails.
+**/
+int spatialWithin(const city_t* city, double lat, double lon, double radius, int** nodes, double** dists);
+
+#endif
@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <string.h>
+#include "strpool.h"
+
+#define INITIAL_CHARS 4096
+#define INITIAL_TABLE 1024
+
+// FNV-1a; names are short, so this is cheap and spreads well enough.
+static uint32_t hash_str(const char* s, size_t* len) {
+    uint32_t h = 2166136261u;
+    size_t n = 0;
+    for (; s[n]; n++) {
+        h ^= (unsigned char) s[n];
+        h *= 16777619u;
+    }
+    *len = n;
+    return h;
+}
+
+static uint32_t find_slot(const strpool_t* pool, const char* s, uint32_t hash) {
+    uint32_t mask = pool->tableSpace - 1;
+    uint32_t i = hash & mask;
+    while (pool->table[i].handle != STRPOOL_NONE) {
+        if (pool->table[i].hash == hash && strcmp(pool->chars + pool->table[i].handle, s) == 0)
+            return i;
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static int grow_table(strpool_t* pool) {
+    uint32_t space = pool->tableSpace * 2;
+    strpool_slot_t* table = malloc(space * sizeof(strpool_slot_t));
+    if (!table) return 0;
+    for (uint32_t i = 0; i < space; i++) table[i].handle = STRPOOL_NONE;
+
+    uint32_t mask = space - 1;
+    for (uint32_t i = 0; i < pool->tableSpace; i++) {
+        if (pool->table[i].handle == STRPOOL_NONE) continue;
+        uint32_t j = pool->table[i].hash & mask;
+        while (table[j].handle != STRPOOL_NONE) j = (j + 1) & mask;
+        table[j] = pool->table[i];
+    }
+    free(pool->table);
+    pool->table = table;
+    pool->tableSpace = space;
+    return 1;
+}
+
+strpool_t* createStrPool(void) {
+    strpool_t* pool = calloc(1, sizeof(strpool_t));
+    if (!pool) return NULL;
+    pool->space = INITIAL_CHARS;
+    pool->chars = malloc(pool->space);
+    pool->tableSpace = INITIAL_TABLE;
+    pool->table = malloc(pool->tableSpace * sizeof(strpool_slot_t));
+    if (!pool->chars || !pool->table) {
+        freeStrPool(pool);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < pool->tableSpace; i++) pool->table[i].handle = STRPOOL_NONE;
+    pool->chars[0] = '\0';
+    pool->size = 1;
+    return pool;
+}
+
+void freeStrPool(strpool_t* pool) {
+    if (!pool) return;
+    free(pool->chars);
+    free(pool->table);
+    free(pool);
+}
+
+uint32_t strpoolIntern(strpool_t* pool, const char* s) {
+    if (!s[0]) return 0;
+
+    size_t len;
+    uint32_t hash = hash_str(s, &len);
+    uint32_t slot = find_slot(pool, s, hash);
+    if (pool->table[slot].handle != STRPOOL_NONE) return pool->table[slot].handle;
+
+    if ((uint64_t) pool->size + len + 1 >= STRPOOL_NONE) return STRPOOL_NONE;
+    if (pool->size + len + 1 > pool->space) {
+        uint64_t space = pool->space;
+        while (space < (uint64_t) pool->size + len + 1) space *= 2;
+        if (space >= STRPOOL_NONE) space = STRPOOL_NONE - 1;
+        char* chars = realloc(pool->chars, space);
+        if (!chars) return STRPOOL_NONE;
+        pool->chars = chars;
+        pool->space = (uint32_t) space;
+    }
+    // Keep the table at most half full.
+    if ((pool->count + 1) * 2 > pool->tableSpace) {
+        if (!grow_table(pool)) return STRPOOL_NONE;
+        slot = find_slot(pool, s, hash);
+    }
+
+    uint32_t handle = pool->size;
+    memcpy(pool->chars + handle, s, len + 1);
+    pool->size += (uint32_t) len + 1;
+    pool->table[slot].hash = hash;
+    pool->table[slot].handle = handle;
+    pool->count++;
+    return handle;
+}
+
+uint32_t strpoolFind(const strpool_t* pool, const char* s) {
+    if (!s[0]) return 0;
+    size_t len;
+    uint32_t hash = hash_str(s, &len);
+    return pool->table[find_slot(pool, s, hash)].handle;
+}
+
+uint32_t strpoolHash(const char* s) {
+    size_t len;
+    return hash_str(s, &len);
+}
+
+const char* strpoolGet(const strpool_t* pool, uint32_t handle) {
+    return pool->chars + handle;
+}
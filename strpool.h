@@ -0,0 +1,66 @@
+#ifndef STRPOOL_H
+#define STRPOOL_H
+
+#include <stdint.h>
+
+#define STRPOOL_NONE UINT32_MAX
+
+/**
+* Interned string pool.
+* Every distinct string is stored once, NUL-terminated, in the
+* contiguous chars buffer; a handle is the byte offset of its first
+* character, so equal strings always have equal handles. Handle 0 is
+* the empty string. An open-addressing table of (hash, handle) pairs
+* finds existing copies when interning.
+**/
+typedef struct {
+    uint32_t hash;
+    uint32_t handle;
+} strpool_slot_t;
+
+typedef struct {
+    char* chars;
+    uint32_t size;
+    uint32_t space;
+    strpool_slot_t* table;
+    uint32_t tableSpace;
+    uint32_t count;
+} strpool_t;
+
+/**
+* Creates an empty pool.
+* @return Pointer to the pool, or NULL if memory allocation fails.
+**/
+strpool_t* createStrPool(void);
+
+/**
+* Frees the pool and every string in it.
+* If the pool pointer is NULL, the function does nothing.
+**/
+void freeStrPool(strpool_t* pool);
+
+/**
+* Returns the handle for a string, adding it if it is not yet present.
+* @return The handle, or STRPOOL_NONE if memory allocation fails.
+**/
+uint32_t strpoolIntern(strpool_t* pool, const char* s);
+
+/**
+* Looks up a string without adding it.
+* @return The handle, or STRPOOL_NONE if the string was never interned.
+**/
+uint32_t strpoolFind(const strpool_t* pool, const char* s);
+
+/**
+* Hash used by the pool (32-bit FNV-1a). It is part of the snapshot
+* format, so it must not change without a snapshot version bump.
+**/
+uint32_t strpoolHash(const char* s);
+
+/**
+* Returns the string for a handle. The pointer is invalidated by the
+* next strpoolIntern() call that adds a string.
+**/
+const char* strpoolGet(const strpool_t* pool, uint32_t handle);
+
+#endif
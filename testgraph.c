@@ -3,11 +3,15 @@
 #include <string.h>
 #include "graph.h"
 #include "testgraph.h"
+#include "strpool.h"
 
 int main() {
     graph_t* g = createGraph();
-    if (!g) {
+    strpool_t* names = createStrPool();
+    if (!g || !names) {
         fprintf(stderr, "Error: Could not create graph.\n");
+        freeGraph(g);
+        freeStrPool(names);
         return 1;
     }
 
@@ -15,6 +19,7 @@ int main() {
     if (scanf("%d", &numPOI) != 1 || numPOI <= 0) {
         fprintf(stderr, "Invalid POI section.\n");
         freeGraph(g);
+        freeStrPool(names);
         return 1;
     }
 
@@ -25,11 +30,24 @@ int main() {
         if (scanf("%d\t%127[^\t]\t%lf\t%lf", &id, name, &lat, &lon) != 4) {
             fprintf(stderr, "Invalid POI data.\n");
             freeGraph(g);
+            freeStrPool(names);
             return 1;
         }
 
-        POIData* poi = malloc(sizeof(POIData));
-        strcpy(poi->name, name);
+        POIData* poi = graphAlloc(g, sizeof(POIData));
+        if (!poi) {
+            fprintf(stderr, "Error: out of memory.\n");
+            freeGraph(g);
+            freeStrPool(names);
+            return 1;
+        }
+        poi->name = strpoolIntern(names, name);
+        if (poi->name == STRPOOL_NONE) {
+            fprintf(stderr, "Error: out of memory.\n");
+            freeGraph(g);
+            freeStrPool(names);
+            return 1;
+        }
         poi->lat = lat;
         poi->lon = lon;
 
@@ -39,6 +57,7 @@ int main() {
     if (scanf("%d", &numRoads) != 1 || numRoads <= 0) {
         fprintf(stderr, "Invalid road section.\n");
         freeGraph(g);
+        freeStrPool(names);
         return 1;
     }
 
@@ -51,16 +70,30 @@ int main() {
         if (scanf("%d\t%d\t%f\t%lf\t%lf\t%127[^\n]", &fromId, &toId, &dist, &lat, &lon, roadName) != 6) {
             fprintf(stderr, "Invalid road data.\n");
             freeGraph(g);
+            freeStrPool(names);
             return 1;
         }
 
-        RoadData* rd = malloc(sizeof(RoadData));
-        strcpy(rd->roadName, roadName);
+        RoadData* rd = graphAlloc(g, sizeof(RoadData));
+        if (!rd) {
+            fprintf(stderr, "Error: out of memory.\n");
+            freeGraph(g);
+            freeStrPool(names);
+            return 1;
+        }
+        rd->roadName = strpoolIntern(names, roadName);
+        if (rd->roadName == STRPOOL_NONE) {
+            fprintf(stderr, "Error: out of memory.\n");
+            freeGraph(g);
+            freeStrPool(names);
+            return 1;
+        }
         addEdge(g, fromId, toId, dist, rd);
     }
 
     printGraph(g);
     freeGraph(g);
+    freeStrPool(names);
     return 0;
 }
 
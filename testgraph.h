@@ -1,14 +1,17 @@
 #ifndef TESTGRAPH_H
 #define TESTGRAPH_H
 
+#include <stdint.h>
+
+/* Names are handles into a strpool_t shared by the whole graph. */
 typedef struct {
-    char name[128];
+    uint32_t name;
     double lat;
     double lon;
 } POIData;
 
 typedef struct {
-    char roadName[128];
+    uint32_t roadName;
 } RoadData;
 
 #endif
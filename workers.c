@@ -0,0 +1,12 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include "workers.h"
+
+void runWorkers(void* (*worker)(void*), void* job, int threads) {
+    pthread_t *ids = threads > 1 ? malloc(sizeof(pthread_t) * threads) : NULL;
+    int started = 1;
+    while (ids && started < threads && pthread_create(&ids[started], NULL, worker, job) == 0) started++;
+    worker(job);
+    for (int i = 1; i < started; ++i) pthread_join(ids[i], NULL);
+    free(ids);
+}
@@ -0,0 +1,14 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+/**
+* Runs worker(job) on up to threads threads (fewer than 1 means 1), the
+* calling thread included, and returns once all of them have returned.
+* Workers are expected to claim their share of the job from a counter
+* in it (an atomic_int), so a thread that cannot be started just leaves
+* its share to the others, and a slow item never holds up items queued
+* behind it on the same thread. Link with -lpthread.
+**/
+void runWorkers(void* (*worker)(void*), void* job, int threads);
+
+#endif
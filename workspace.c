@@ -0,0 +1,135 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include "workspace.h"
+
+#define WORKSPACE_MIN_HEAP 64
+
+search_workspace_t* createWorkspace(void) {
+    search_workspace_t *ws = calloc(1, sizeof(search_workspace_t));
+    if (!ws) return NULL;
+    ws->heapKind = HEAP_QUAD;
+    for (int d = 0; d < 2; ++d) {
+        for (int b = 0; b < RADIX_BUCKETS; ++b) ws->radix[d].head[b] = -1;
+    }
+    return ws;
+}
+
+void freeWorkspace(search_workspace_t* ws) {
+    if (!ws) return;
+    for (int d = 0; d < 2; ++d) {
+        free(ws->dist[d]);
+        free(ws->reached[d]);
+        free(ws->settled[d]);
+        free(ws->heap[d]);
+        free(ws->pos[d]);
+        free(ws->radix[d].next);
+        free(ws->radix[d].prev);
+        free(ws->radix[d].key);
+    }
+    free(ws->estimate);
+    free(ws);
+}
+
+// realloc that leaves *p untouched on failure.
+static int grow(void **p, size_t bytes) {
+    void *grown = realloc(*p, bytes ? bytes : 1);
+    if (!grown) return 0;
+    *p = grown;
+    return 1;
+}
+
+int workspaceReset(search_workspace_t* ws, int nodeCount) {
+    if (nodeCount > ws->nodeCount) {
+        size_t n = nodeCount;
+        int ok = grow((void**) &ws->estimate, sizeof(double) * n);
+        for (int d = 0; d < 2; ++d) {
+            radix_heap_t *r = &ws->radix[d];
+            ok = ok && grow((void**) &ws->dist[d], sizeof(double) * n)
+                    && grow((void**) &ws->reached[d], sizeof(unsigned int) * n)
+                    && grow((void**) &ws->settled[d], sizeof(unsigned int) * n)
+                    && grow((void**) &ws->pos[d], sizeof(int) * n);
+            // The radix heap shares pos; point it at the new array before
+            // anything else can fail, or it would keep the freed one.
+            if (ok) r->pos = ws->pos[d];
+            ok = ok && grow((void**) &r->next, sizeof(int) * n)
+                    && grow((void**) &r->prev, sizeof(int) * n)
+                    && grow((void**) &r->key, sizeof(double) * n);
+        }
+        if (!ok) return 0;
+        // New entries must not look stamped; restart the epochs so
+        // every stamp, old or new, is below the next one.
+        for (int d = 0; d < 2; ++d) {
+            memset(ws->reached[d], 0, sizeof(unsigned int) * n);
+            memset(ws->settled[d], 0, sizeof(unsigned int) * n);
+        }
+        ws->nodeCount = nodeCount;
+        ws->epoch = 0;
+    }
+    if (ws->epoch == UINT_MAX) {
+        for (int d = 0; d < 2; ++d) {
+            memset(ws->reached[d], 0, sizeof(unsigned int) * ws->nodeCount);
+            memset(ws->settled[d], 0, sizeof(unsigned int) * ws->nodeCount);
+        }
+        ws->epoch = 0;
+    }
+    ws->epoch++;
+    for (int d = 0; d < 2; ++d) {
+        ws->heapSize[d] = 0;
+        if (ws->radix[d].pos) radixHeapClear(&ws->radix[d]);
+    }
+    return 1;
+}
+
+int workspacePush(search_workspace_t* ws, int side, int v, double dist, double key) {
+    // A node first reached in this query is not queued, whatever its
+    // pos says from earlier queries.
+    if (ws->reached[side][v] != ws->epoch) ws->pos[side][v] = -1;
+    heap_item_t item = {v, key};
+
+    if (ws->heapKind == HEAP_RADIX) {
+        radixHeapUpdate(&ws->radix[side], item);
+    } else {
+        int grows = ws->heapKind == HEAP_BINARY || ws->pos[side][v] < 0;
+        if (grows && ws->heapSize[side] == ws->heapSpace[side]) {
+            int space = ws->heapSpace[side] ? ws->heapSpace[side] * 2 : WORKSPACE_MIN_HEAP;
+            if (!grow((void**) &ws->heap[side], sizeof(heap_item_t) * (size_t) space)) return 0;
+            ws->heapSpace[side] = space;
+        }
+        if (ws->heapKind == HEAP_QUAD) quadHeapUpdate(ws->heap[side], &ws->heapSize[side], ws->pos[side], item);
+        else heapPush(ws->heap[side], &ws->heapSize[side], item);
+    }
+    ws->dist[side][v] = dist;
+    ws->reached[side][v] = ws->epoch;
+    return 1;
+}
+
+int workspaceQueued(const search_workspace_t* ws, int side) {
+    return ws->heapKind == HEAP_RADIX ? ws->radix[side].size : ws->heapSize[side];
+}
+
+double workspaceTop(search_workspace_t* ws, int side) {
+    return ws->heapKind == HEAP_RADIX ? radixHeapTop(&ws->radix[side]) : ws->heap[side][0].dist;
+}
+
+heap_item_t workspacePop(search_workspace_t* ws, int side) {
+    if (ws->heapKind == HEAP_RADIX) return radixHeapPop(&ws->radix[side]);
+    if (ws->heapKind == HEAP_QUAD) return quadHeapPop(ws->heap[side], &ws->heapSize[side], ws->pos[side]);
+    return heapPop(ws->heap[side], &ws->heapSize[side]);
+}
+
+void workspaceClear(search_workspace_t* ws, int side) {
+    if (ws->heapKind == HEAP_RADIX) {
+        radixHeapClear(&ws->radix[side]);
+        return;
+    }
+    if (ws->heapKind == HEAP_QUAD) {
+        for (int i = 0; i < ws->heapSize[side]; ++i) ws->pos[side][ws->heap[side][i].idx] = -1;
+    }
+    ws->heapSize[side] = 0;
+}
+
+double workspaceDist(const search_workspace_t* ws, int side, int v) {
+    return ws->reached[side][v] == ws->epoch ? ws->dist[side][v] : INFINITY;
+}
@@ -0,0 +1,91 @@
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+#include "heap.h"
+
+/**
+* Scratch memory for shortest path searches, kept across queries so a
+* query costs time in proportion to the nodes it reaches rather than
+* the size of the graph.
+* Each search side d (0 forward, 1 backward) has a dist array and a
+* priority queue. dist[d][v] is only meaningful while reached[d][v] ==
+* epoch, and v is settled while settled[d][v] == epoch;
+* workspaceReset() starts a query by bumping epoch, which invalidates
+* every entry at once.
+* estimate caches the A* heuristic of side 0 and is valid like dist[0].
+* heapKind picks the queue (HEAP_QUAD by default) and may be changed
+* between queries. The binary heap grows on demand; the indexed queues
+* hold each node once, in per-node arrays.
+* A workspace is not thread-safe; give each thread its own.
+**/
+typedef struct {
+    int nodeCount;              // capacity of the per-node arrays
+    unsigned int epoch;
+    heap_kind_t heapKind;
+    double* dist[2];
+    double* estimate;
+    unsigned int* reached[2];
+    unsigned int* settled[2];
+    heap_item_t* heap[2];       // HEAP_BINARY and HEAP_QUAD
+    int heapSize[2];
+    int heapSpace[2];
+    int* pos[2];                // HEAP_QUAD slot / HEAP_RADIX bucket
+    radix_heap_t radix[2];
+} search_workspace_t;
+
+/**
+* Creates an empty workspace; arrays are allocated by workspaceReset().
+* @return The workspace, or NULL if memory allocation fails.
+**/
+search_workspace_t* createWorkspace(void);
+
+/**
+* Frees a workspace and its arrays. NULL is ignored.
+**/
+void freeWorkspace(search_workspace_t* ws);
+
+/**
+* Starts a new query on a graph of nodeCount nodes: grows the per-node
+* arrays if needed, empties both queues and invalidates every dist and
+* settled mark. O(1) unless the arrays grow or epoch wraps around
+* (plus, for HEAP_RADIX, the nodes the last query left queued).
+* @return 1 on success, 0 if memory allocation fails.
+**/
+int workspaceReset(search_workspace_t* ws, int nodeCount);
+
+/**
+* Sets dist[side][v] = dist, marks v reached and queues v on that side
+* with the given key (dist, or dist plus an A* estimate). With the
+* indexed queues this lowers v's key if it is already queued.
+* @return 1 on success, 0 if memory allocation fails.
+**/
+int workspacePush(search_workspace_t* ws, int side, int v, double dist, double key);
+
+/**
+* Number of queue entries on one side (with HEAP_BINARY, including
+* stale duplicates).
+**/
+int workspaceQueued(const search_workspace_t* ws, int side);
+
+/**
+* Smallest key queued on one side; the side must not be empty.
+**/
+double workspaceTop(search_workspace_t* ws, int side);
+
+/**
+* Removes and returns the entry with the smallest key on one side.
+* The side must not be empty.
+**/
+heap_item_t workspacePop(search_workspace_t* ws, int side);
+
+/**
+* Drops everything queued on one side.
+**/
+void workspaceClear(search_workspace_t* ws, int side);
+
+/**
+* Distance of v on one side, INFINITY if not reached in this query.
+**/
+double workspaceDist(const search_workspace_t* ws, int side, int v);
+
+#endif